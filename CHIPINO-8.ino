@@ -1,11 +1,18 @@
 #include <SPI.h>
 #include <SD.h>
 
+#include "hal_arduino.h"
 #include "screen.h"
 #include "keyboard.h"
 #include "memory.h"
 #include "speaker.h"
 #include "cpu.h"
+#include "presenter.h"
+#include "scheduler.h"
+#include "latency.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "input_log.h"
 
 // Pins display is connected to
 #define OLED_MOSI   A4 //D1
@@ -31,24 +38,81 @@ byte keys2[] = {4, 5, 6, 7};
 // Pin that buzzer is connected to
 #define SOUND_PIN 8
 
+// Serial port speed
+#define SERIAL_BAUD 115200
+// Character requesting the latency report over serial
+#define LATENCY_REPORT 'l'
+// Character requesting the execution profile over serial
+#define PROFILE_REPORT 'p'
+// Characters requesting machine state to be saved to and restored from SD
+#define SAVE_STATE 's'
+#define LOAD_STATE 'r'
+// File on SD that machine state is saved to
+#define STATE_FILE "STATE.C8S"
+
+// Interpreter whose quirks the ROM expects, one of QuirkProfile
+#define QUIRK_PROFILE PROFILE_MODERN
+
+// Set to 1 to record keys from reset, for replay on the host
+#define RECORD_INPUT 0
+// Character requesting the input log to be written to SD
+#define SAVE_INPUT_LOG 'i'
+// File on SD that input log is written to
+#define INPUT_LOG_FILE "INPUT.C8I"
+// Size of the input log buffer, 4 bytes per key change
+#define INPUT_LOG_SIZE 2048
+
 // Byte array representing CHIP-8 memory locations
 // for some reason can not be created dinamicly in class
 byte mem[MEMORY_SIZE];
 
-// Keyboard object
-Keyboard keyboard(keys1, keys2);
+// Work buffer of save states, static so that saving never allocates
+byte snapshot[SNAPSHOT_MAX_SIZE];
+
+#if RECORD_INPUT
+// Keys of each frame, written to SD on request
+byte inputLogBuffer[INPUT_LOG_SIZE];
+InputLog inputLog(inputLogBuffer, INPUT_LOG_SIZE);
+#endif
+
+// Hardware backends
+ArduinoInput input(hexaKeys, keys1, keys2);
+ArduinoDisplay display(OLED_MOSI, OLED_CLK, OLED_DC, OLED_RESET, OLED_CS);
+ArduinoStorage storage(SD_CS);
+ArduinoAudio audio(SOUND_PIN);
+ArduinoClock systemClock;
+ArduinoFrameTimer frameTimer;
+ArduinoRng rng(RANDOM);
+ArduinoLog serialLog;
+
+// Measures key edge to screen latency
+InputLatency latency(systemClock);
+
+#if CPU_PROFILE
+// Execution profile, CPU_PROFILE is set in profiler.h
+Profiler profiler;
+#endif
+
+// Keyboard object, scanned by the scheduler
+Keyboard keyboard(input, systemClock);
 
 // Screen object
-Screen screen(OLED_MOSI, OLED_CLK, OLED_DC, OLED_RESET, OLED_CS, 2);
+Screen screen(display, 2);
 
 // Memory object
-Memory memory(SD_CS, mem);
+Memory memory(storage, mem);
 
 // Speaker object
-Speaker speaker(SOUND_PIN);
+Speaker speaker(audio);
 
 // CPU object
-CPU cpu(memory, screen, keyboard, speaker, RANDOM);
+CPU cpu(memory, screen, keyboard, speaker, systemClock, rng);
+
+// Shows the screen once per frame
+Presenter presenter(screen, systemClock);
+
+// Runs CPU in 60 Hz frames
+Scheduler scheduler(cpu, keyboard, presenter, frameTimer);
 
 
 void setup() {
@@ -57,6 +121,13 @@ void setup() {
     pinMode(8, OUTPUT);
     digitalWrite(8, HIGH);
     ///////////////////////////////////
+    Serial.begin(SERIAL_BAUD);
+    keyboard.setLatency(&latency);
+    screen.setLatency(&latency);
+#if CPU_PROFILE
+    cpu.setProfiler(&profiler);
+    presenter.setProfiler(&profiler);
+#endif
     screen.displayText("LOADING ROM...\n");
     delay(500);
     if (!memory.initialize()) {
@@ -65,16 +136,50 @@ void setup() {
         if (!memory.loadRom(romName)) {
             screen.displayText("Error loading ROM!");
         } else {
+            cpu.setQuirkProfile(QUIRK_PROFILE);
             screen.clear();
+#if RECORD_INPUT
+            // Run is repeatable from the seed and the logged keys
+            uint32_t seed = rng.random(0x7FFFFFFF) + 1;
+            cpu.seedRandom(seed);
+            inputLog.startRecording(QUIRK_PROFILE, seed, scheduler.getInstructionsPerFrame(), Snapshot::checksum(mem, MEMORY_SIZE));
+            scheduler.setInputLog(&inputLog);
+#endif
         }
     }
+    frameTimer.begin(FRAME_RATE, timer, NULL);
 }
 
 // Timer interupts
-void timer(struct tc_module *const module_inst) {
-    cpu.decrementTimers();
+void timer(void *context) {
+    scheduler.onTimer();
 }
 
 void loop() {
-    cpu.run();
+    if (Serial.available() > 0) {
+        char request = Serial.read();
+        if (request == LATENCY_REPORT) {
+            latency.report(serialLog);
+        }
+        if (request == SAVE_STATE) {
+            serialLog.print(Snapshot::save(cpu, memory, screen, storage, STATE_FILE, snapshot)
+                ? "State saved\n" : "Error saving state!\n");
+        }
+        if (request == LOAD_STATE) {
+            serialLog.print(Snapshot::restore(cpu, memory, screen, storage, STATE_FILE, snapshot)
+                ? "State restored\n" : "Error restoring state!\n");
+        }
+#if RECORD_INPUT
+        if (request == SAVE_INPUT_LOG) {
+            serialLog.print(inputLog.save(storage, INPUT_LOG_FILE)
+                ? (inputLog.isFull() ? "Input log saved, full\n" : "Input log saved\n") : "Error saving input log!\n");
+        }
+#endif
+#if CPU_PROFILE
+        if (request == PROFILE_REPORT) {
+            profiler.report(serialLog);
+        }
+#endif
+    }
+    scheduler.run();
 }
@@ -1,10 +1,21 @@
 #include "cpu.h"
 
-CPU::CPU(Memory memory, Screen screen, Keyboard keyboard, Speaker speaker, int seed) : memory(memory), screen(screen), keyboard(keyboard), speaker(speaker), seed(seed) {
+#include <string.h>
+
+CPU::CPU(Memory &memory, Screen &screen, Keyboard &keyboard, Speaker &speaker, Clock &clock, Rng &rng) : memory(memory), screen(screen), keyboard(keyboard), speaker(speaker), clock(clock), rng(rng), cache(memory) {
     reset();
-    pinMode(seed, INPUT);
-    randomSeed(analogRead(seed));
-    lastMillis = millis() + TIMER_DELAY;
+    rng.seed();
+    seedRandom((uint32_t)rng.random(0x7FFFFFFF));
+    for (int i = 0; i < FUSION_COUNT; i++) {
+        fusionHits[i] = 0;
+    }
+    draws = 0;
+    idleInstructions = 0;
+    idle = false;
+    core = &cores[PROFILE_MODERN];
+#if CPU_PROFILE
+    profiler = NULL;
+#endif
 }
 
 void CPU::reset() {
@@ -12,40 +23,299 @@ void CPU::reset() {
         regV[i] = 0x0;
     }
     pc = PC_START;
-    regStack = STACK_START;
+    for (int i = 0; i < STACK_SIZE; i++) {
+        stack[i] = 0;
+    }
+    regStack = 0;
     regI = 0;
     timerDelay = 0;
     timerSound = 0;
+    waitingForKey = false;
+    waitedKey = NO_KEY_PRESSED;
 }
 
-void CPU::decrementTimers() {
-    int t = millis();
-    if (lastMillis < t) {
-        lastMillis = t + TIMER_DELAY;
-        if (timerSound > 0) {
-            timerSound--;
-            speaker.playSound();
-        } else {
-            speaker.muteSound();
-        }
-        if (timerDelay > 0) {
-            timerDelay--;
+void CPU::seedRandom(uint32_t seed) {
+    randomState = seed ? seed : 1;
+}
+
+bool CPU::setQuirkProfile(int profile) {
+    if (profile < 0 || profile >= PROFILE_COUNT) {
+        return false;
+    }
+    core = &cores[profile];
+    return true;
+}
+
+int CPU::getQuirkProfile() {
+    return core - cores;
+}
+
+byte CPU::getQuirks() {
+    return core->quirks;
+}
+
+const char *CPU::getQuirkProfileName(int profile) {
+    return cores[profile].name;
+}
+
+int CPU::findQuirkProfile(const char *name) {
+    for (int profile = 0; profile < PROFILE_COUNT; profile++) {
+        if (strcmp(cores[profile].name, name) == 0) {
+            return profile;
         }
     }
+    return -1;
+}
+
+void CPU::decrementTimers() {
+    if (timerSound > 0) {
+        timerSound--;
+        speaker.playSound();
+    } else {
+        speaker.muteSound();
+    }
+    if (timerDelay > 0) {
+        timerDelay--;
+    }
+}
+
+void CPU::saveState(StateWriter &out) {
+    out.putBytes(regV, NUM_REGISTERS);
+    // I and PC can run past the address space, so all of them is kept
+    out.putLong(regI);
+    out.putLong(pc);
+    out.putWord(regStack);
+    for (int i = 0; i < STACK_SIZE; i++) {
+        out.putWord(stack[i]);
+    }
+    out.putByte(timerDelay);
+    out.putByte(timerSound);
+    out.putByte(waitingForKey);
+    out.putByte(waitedKey);
+    out.putLong(randomState);
+}
+
+bool CPU::loadState(StateReader &in) {
+    byte registers[NUM_REGISTERS];
+    in.getBytes(registers, NUM_REGISTERS);
+    int location = (int)in.getLong();
+    int counter = (int)in.getLong();
+    // No run takes I or PC below zero, such a snapshot is corrupt
+    if (location < 0 || counter < 0) {
+        return false;
+    }
+    for (int i = 0; i < NUM_REGISTERS; i++) {
+        regV[i] = registers[i];
+    }
+    regI = location;
+    pc = counter;
+    regStack = in.getWord() & (STACK_SIZE - 1);
+    for (int i = 0; i < STACK_SIZE; i++) {
+        stack[i] = in.getWord();
+    }
+    timerDelay = in.getByte();
+    timerSound = in.getByte();
+    waitingForKey = in.getByte() != 0;
+    waitedKey = in.getByte();
+    seedRandom(in.getLong());
+    idle = false;
+    return true;
 }
 
 void CPU::executeNextCommand() {
-    byte opcode1 = memory.getByte(pc);
-    int opcode = (int)opcode1 << 8;
-    byte opcode2 = memory.getByte(pc + 1);
-    //
-    opcode += opcode2;
+    const Instruction &instruction = cache.fetch(pc);
     pc += 2;
-    execute(opcode);
-    decrementTimers();
+    (this->*core->execute)(instruction);
 }
 
 void CPU::execute(int opcode) {
+    (this->*core->executeOpcode)(opcode);
+}
+
+template <int QUIRKS>
+void CPU::execute(const Instruction &instruction) {
+    switch (instruction.op) {
+#define STOP_RUN return
+#define OPERATION(op, body) case op: body; break;
+#include "operations.h"
+#undef OPERATION
+#undef STOP_RUN
+    }
+}
+
+int CPU::run(int count) {
+#if CPU_PROFILE
+    if (profiler) {
+        return runProfiled(count);
+    }
+#endif
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+    return runThreaded(count);
+#else
+    return runSwitch(count);
+#endif
+}
+
+#if CPU_PROFILE
+
+void CPU::setProfiler(Profiler *profiler) {
+    this->profiler = profiler;
+}
+
+int CPU::runProfiled(int count) {
+    for (int i = 0; i < count; i++) {
+        int location = pc;
+        const Instruction &instruction = cache.fetch(pc);
+        pc += 2;
+        uint32_t start = clock.cycles();
+        (this->*core->execute)(instruction);
+        profiler->record(instruction.op, location, clock.cycles() - start);
+        if (waitingForKey) {
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+#endif
+
+int CPU::runReference(int count) {
+    for (int i = 0; i < count; i++) {
+        int opcode = (memory.getByte(pc) << 8) | memory.getByte(pc + 1);
+        pc += 2;
+        execute(opcode);
+        if (waitingForKey) {
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+int CPU::runSwitch(int count) {
+    return (this->*core->runSwitch)(count);
+}
+
+int CPU::runThreaded(int count) {
+    return (this->*core->runThreaded)(count);
+}
+
+template <int QUIRKS>
+int CPU::runSwitchCore(int count) {
+    for (int i = 0; i < count; i++) {
+        const Instruction &instruction = cache.fetch(pc);
+        pc += 2;
+        execute<QUIRKS>(instruction);
+        if (waitingForKey) {
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+#ifdef __GNUC__
+
+template <int QUIRKS>
+int CPU::runThreadedCore(int count) {
+    static const void *const labels[] = {
+#define OPERATION(op, body) &&label_##op,
+#include "operations.h"
+#undef OPERATION
+#define FUSION(op, length, handler) &&label_##op,
+#include "fusions.h"
+#undef FUSION
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == FUSION_END, "operations.h and fusions.h do not match Operation and Fusion");
+
+    const int total = count;
+    const Instruction *next;
+
+// Fetches next instruction and jumps to its handler, or to the handler
+// of the sequence starting there if all of it fits the count
+#define DISPATCH() \
+    if (count <= 0) { \
+        return total - count; \
+    } \
+    next = &cache.fetch(pc); \
+    pc += 2; \
+    if (next->length <= count) { \
+        goto *labels[next->fused]; \
+    } \
+    goto *labels[next->op]
+
+    DISPATCH();
+
+#define STOP_RUN return total - count
+#define OPERATION(op, body) \
+    label_##op: { \
+        const Instruction &instruction = *next; \
+        (void)instruction; \
+        count--; \
+        body; \
+    } \
+    DISPATCH();
+#include "operations.h"
+#undef OPERATION
+#undef STOP_RUN
+#define FUSION(op, length, handler) \
+    label_##op: \
+        fusionHits[op - OP_COUNT]++; \
+        count -= handler<QUIRKS>(*next, count); \
+    DISPATCH();
+#include "fusions.h"
+#undef FUSION
+#undef DISPATCH
+}
+
+#else
+
+#define STOP_RUN return
+#define OPERATION(op, body) \
+template <int QUIRKS> \
+void CPU::handle_##op(const Instruction &instruction) { \
+    (void)instruction; \
+    body; \
+}
+#include "operations.h"
+#undef OPERATION
+#undef STOP_RUN
+
+template <int QUIRKS>
+int CPU::runThreadedCore(int count) {
+    static void (CPU::*const handlers[])(const Instruction &) = {
+#define OPERATION(op, body) &CPU::handle_##op<QUIRKS>,
+#include "operations.h"
+#undef OPERATION
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == OP_COUNT, "operations.h does not match Operation");
+    static int (CPU::*const fusedHandlers[])(const Instruction &, int) = {
+#define FUSION(op, length, handler) &CPU::handler<QUIRKS>,
+#include "fusions.h"
+#undef FUSION
+    };
+    static_assert(sizeof(fusedHandlers) / sizeof(fusedHandlers[0]) == FUSION_COUNT, "fusions.h does not match Fusion");
+
+    const int total = count;
+    while (count > 0) {
+        const Instruction &instruction = cache.fetch(pc);
+        pc += 2;
+        if (instruction.fused != instruction.op && instruction.length <= count) {
+            fusionHits[instruction.fused - OP_COUNT]++;
+            count -= (this->*fusedHandlers[instruction.fused - OP_COUNT])(instruction, count);
+        } else {
+            count--;
+            (this->*handlers[instruction.op])(instruction);
+            if (waitingForKey) {
+                return total - count;
+            }
+        }
+    }
+    return total - count;
+}
+
+#endif
+
+template <int QUIRKS>
+void CPU::executeOpcode(int opcode) {
     int command = (opcode & 0xF000) >> 12;
     int reg, reg1, reg2, val, location;
     switch (command) {
@@ -100,13 +370,13 @@ void CPU::execute(int opcode) {
                     registerMove(reg1, reg2);
                     break;
                 case 0x1: // Sets reg1 to the value of reg1 or reg2.
-                    registerOr(reg1, reg2);
+                    registerOr<QUIRKS>(reg1, reg2);
                     break;
                 case 0x2: // Sets reg1 to the value of reg1 and reg2.
-                    registerAnd(reg1, reg2);
+                    registerAnd<QUIRKS>(reg1, reg2);
                     break;
                 case 0x3: // Sets reg1 to the value of reg1 xor reg2.
-                    registerXor(reg1, reg2);
+                    registerXor<QUIRKS>(reg1, reg2);
                     break;
                 case 0x4: // Adds reg2 to reg1. VF is set to 1 when there's a carry, and to 0 when there isn't.
                     registerAdd(reg1, reg2);
@@ -115,13 +385,13 @@ void CPU::execute(int opcode) {
                     registerSubN(reg1, reg2);
                     break;
                 case 0x6: // Shifts reg1 right by one. VF is set to the value of the least significant bit of reg1 before the shift.
-                    registerShiftRight(reg1);
+                    registerShiftRight<QUIRKS>(reg1, reg2);
                     break;
                 case 0x7: // Sets reg1 to reg2 minus reg1. VF is set to 0 when there's a borrow, and 1 when there isn't.
                     registerSub(reg1, reg2);
                     break;
                 case 0xE: // Shifts VX left by one. VF is set to the value of the most significant bit of VX before the shift
-                    registerShiftLeft(reg1);
+                    registerShiftLeft<QUIRKS>(reg1, reg2);
                     break;
             }
             break;
@@ -136,7 +406,7 @@ void CPU::execute(int opcode) {
             break;
         case 0xB: // Jumps to the address plus V0.
             location = (opcode & 0x0FFF);
-            jumpToAddressPlusV0(location);
+            jumpToAddressPlusV0<QUIRKS>(location);
             break;
         case 0xC: // Sets register to the result of a bitwise and operation on a random number and value.
             reg = (opcode & 0x0F00) >> 8;
@@ -148,7 +418,7 @@ void CPU::execute(int opcode) {
             reg2 = (opcode & 0x00F0) >> 4;
             val = (opcode & 0x000F);
             //screen.displayText("Dosao!");
-            drawSprite(reg1, reg2, val);
+            drawSprite<QUIRKS>(reg1, reg2, val);
             break;
         case 0xE:
             switch (opcode & 0x00FF) {
@@ -187,26 +457,112 @@ void CPU::execute(int opcode) {
                     storeDecimalInMemory(reg);
                     break;
                 case 0x55: // Stores V0 to VX (including VX) in memory starting at address I.[4]
-                    storeRegistersInMemory(reg);
+                    storeRegistersInMemory<QUIRKS>(reg);
                     break;
                 case 0x65: // Fills V0 to VX (including VX) with values from memory starting at address I. [4]
-                    storeMemoryToRegisters(reg);
+                    storeMemoryToRegisters<QUIRKS>(reg);
                     break;
             }
             break;
     }
 }
 
-void CPU::run() {
-    if (timerDelay == 0) {
-        executeNextCommand();
+byte CPU::getRegister(int reg) {
+    return regV[reg];
+}
+
+int CPU::getPC() {
+    return pc;
+}
+
+uint32_t CPU::getFusionHits(int fusion) {
+    return fusionHits[fusion - OP_COUNT];
+}
+
+bool CPU::wasIdle() {
+    bool result = idle;
+    idle = false;
+    return result;
+}
+
+unsigned long CPU::getDraws() {
+    return draws;
+}
+
+unsigned long CPU::getIdleInstructions() {
+    return idleInstructions;
+}
+
+bool CPU::isWaitingForKey() {
+    return waitingForKey;
+}
+
+// Fused sequences, pc is already past the first instruction
+template <int QUIRKS>
+int CPU::fusedWaitDelay(const Instruction &instruction, int count) {
+    int start = pc - 2;
+    setRegisterToDelayTimer(instruction.x);
+    if (regV[instruction.z] == instruction.nn) {
+        pc += 4;
+        return 2;
+    }
+    jumpToAddress(instruction.nnn);
+    if (pc != start) {
+        return 3;
+    }
+    // Delay timer only changes between frames
+    return 3 + skipIdle(count - 3, 3);
+}
+
+template <int QUIRKS>
+int CPU::fusedSetDraw(const Instruction &instruction, int) {
+    setRegisterToValue(instruction.x, instruction.nn);
+    setIToAddress(instruction.nnn);
+    drawSprite<QUIRKS>(instruction.z, instruction.y, instruction.n);
+    pc += 4;
+    return 3;
+}
+
+template <int QUIRKS>
+int CPU::fusedSetIDraw(const Instruction &instruction, int) {
+    setIToAddress(instruction.nnn);
+    drawSprite<QUIRKS>(instruction.x, instruction.y, instruction.n);
+    pc += 2;
+    return 2;
+}
+
+template <int QUIRKS>
+int CPU::fusedCount(const Instruction &instruction, int) {
+    addValueToRegister(instruction.x, instruction.nn);
+    pc += 2;
+    skipIfRegisterEqualValue(instruction.z, instruction.nnn);
+    return 2;
+}
+
+template <int QUIRKS>
+int CPU::fusedWaitKey(const Instruction &instruction, int count) {
+    int start = pc - 2;
+    if (instruction.op == OP_SKIP_KEY_PRESSED) {
+        skipIfKeyPressed(instruction.x);
+    } else {
+        skipIfKeyNotPressed(instruction.x);
+    }
+    if (pc != start + 2) {
+        return 1;
     }
-    decrementTimers();
-    /*  if (millis() - lastMillis > 1000) {
-        decrementTimers();
-        lastMillis += 1000;
-        }*/
-    //delay(CPU_DELAY);
+    jumpToAddress(instruction.nnn);
+    if (pc != start) {
+        return 2;
+    }
+    // Keys are only scanned between frames
+    return 2 + skipIdle(count - 2, 2);
+}
+
+int CPU::skipIdle(int count, int length) {
+    int skipped = count - count % length;
+    idleInstructions += skipped;
+    idle = true;
+    return skipped;
 }
 
 // 0x0XXX
@@ -215,10 +571,8 @@ void CPU::clearScreen() {
 }
 
 void CPU::returnFromSubrutine() {
-    regStack--;
-    pc = memory.getByte(regStack) << 8;
-    regStack--;
-    pc += memory.getByte(regStack);
+    regStack = (regStack - 1) & (STACK_SIZE - 1);
+    pc = stack[regStack];
 }
 
 // 0x1XXX
@@ -228,10 +582,8 @@ void CPU::jumpToAddress(int location) {
 
 // 0x2XXX
 void CPU::callSubroutine(int location) {
-    memory.setByte(regStack, (pc & 0x00FF));
-    regStack++;
-    memory.setByte(regStack, ((pc & 0xFF00) >> 8));
-    regStack++;
+    stack[regStack] = pc;
+    regStack = (regStack + 1) & (STACK_SIZE - 1);
     pc = location;
 }
 
@@ -271,53 +623,62 @@ void CPU::registerMove(int reg1, int reg2) {
     regV[reg1] = regV[reg2];
 }
 
+template <int QUIRKS>
 void CPU::registerOr(int reg1, int reg2) {
     regV[reg1] |= regV[reg2];
+    if (QUIRKS & QUIRK_VF_RESET) {
+        regV[0xF] = 0;
+    }
 }
 
+template <int QUIRKS>
 void CPU::registerAnd(int reg1, int reg2) {
     regV[reg1] &= regV[reg2];
+    if (QUIRKS & QUIRK_VF_RESET) {
+        regV[0xF] = 0;
+    }
 }
 
+template <int QUIRKS>
 void CPU::registerXor(int reg1, int reg2) {
     regV[reg1] ^= regV[reg2];
+    if (QUIRKS & QUIRK_VF_RESET) {
+        regV[0xF] = 0;
+    }
 }
 
+// Flags are written after the result, so that VF as the first
+// register ends up holding the flag
 void CPU::registerAdd(int reg1, int reg2) {
-    if (regV[reg1] + regV[reg2] < regV[reg2] || regV[reg1] + regV[reg2] < regV[reg1]) {
-        regV[0xF] = 0x01;
-    } else {
-        regV[0xF] = 0x00;
-    }
-    regV[reg1] += regV[reg2];
+    int sum = regV[reg1] + regV[reg2];
+    regV[reg1] = (byte)sum;
+    regV[0xF] = sum > 0xFF;
 }
 
 void CPU::registerSubN(int reg1, int reg2) {
-    if (regV[reg1] > regV[reg2]) {
-        regV[0xF] = 0x01;
-    } else {
-        regV[0xF] = 0x00;
-    }
+    byte flag = regV[reg1] >= regV[reg2];
     regV[reg1] -= regV[reg2];
+    regV[0xF] = flag;
 }
 
-void CPU::registerShiftRight(int reg) {
-    regV[0xF] = regV[reg] & 0x01;
-    regV[reg] = regV[reg] >> 1;
+template <int QUIRKS>
+void CPU::registerShiftRight(int reg1, int reg2) {
+    byte value = regV[QUIRKS & QUIRK_SHIFT_VY ? reg2 : reg1];
+    regV[reg1] = value >> 1;
+    regV[0xF] = value & 0x01;
 }
 
 void CPU::registerSub(int reg1, int reg2) {
-    if (regV[reg1] < regV[reg2]) {
-        regV[0xF] = 0x01;
-    } else {
-        regV[0xF] = 0x00;
-    }
-    regV[reg1] -= regV[reg2];
+    byte flag = regV[reg2] >= regV[reg1];
+    regV[reg1] = regV[reg2] - regV[reg1];
+    regV[0xF] = flag;
 }
 
-void CPU::registerShiftLeft(int reg) {
-    regV[0xF] = regV[reg] & 0x80;
-    regV[reg] <<= 1;
+template <int QUIRKS>
+void CPU::registerShiftLeft(int reg1, int reg2) {
+    byte value = regV[QUIRKS & QUIRK_SHIFT_VY ? reg2 : reg1];
+    regV[reg1] = value << 1;
+    regV[0xF] = value >> 7;
 }
 
 // 0x9XXX
@@ -333,58 +694,60 @@ void CPU::setIToAddress(int location) {
 }
 
 // 0xBXXX
+template <int QUIRKS>
 void CPU::jumpToAddressPlusV0(int location) {
     //pc = (location + regI) & 0x0FFF;
-    pc = (location + regV[0x0]) & 0x0FFF;
+    pc = (location + regV[QUIRKS & QUIRK_JUMP_VX ? location >> 8 : 0x0]) & 0x0FFF;
 }
 
 // 0xCXXX
 void CPU::setRegisterToRandomValue(int reg, int val) {
-    regV[reg] = (byte) (val & random(0xFF));
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    // Range of random(0xFF) it replaces, 0xFF is never drawn
+    regV[reg] = (byte) (val & (randomState % 0xFF));
 }
 
 // 0xDXXX
+template <int QUIRKS>
 void CPU::drawSprite(int reg1, int reg2, int val) {
+    draws++;
     regV[0xF] = 0;
 
+    int x = regV[reg1];
+    int y = regV[reg2];
+    // Sprite bits kept, clipping starts the sprite on screen and drops
+    // rows and columns past the edges
+    byte columns = 0xFF;
+    if (QUIRKS & QUIRK_CLIP) {
+        x %= screen.getWidth();
+        y %= screen.getHeight();
+        if (y + val > screen.getHeight()) {
+            val = screen.getHeight() - y;
+        }
+        if (x + 8 > screen.getWidth()) {
+            columns <<= x + 8 - screen.getWidth();
+        }
+    }
     for (int j = 0; j < val; j++) {
-
-        byte colorByte = memory.getByte(regI + j);
-        int y = regV[reg2] + j;
-        y = y % screen.getHeight();
-
-        int mask = 0x80;
-
-        for (int i = 0; i < 8; i++) {
-            int x = regV[reg1] + i;
-            x = x % screen.getWidth();
-
-            bool turnOn = (colorByte & mask) != 0;
-            bool currentOn = screen.isPixelOn(x, y);
-
-            if (turnOn && currentOn) {
-                regV[0xF] |= 1;
-                turnOn = false;
-            } else if (!turnOn && currentOn) {
-                turnOn = true;
-            }
-
-            screen.markPixel(x, y, turnOn);
-            mask = mask >> 1;
+        byte colorByte = memory.getByte(regI + j) & columns;
+        if (screen.drawRow(x, (y + j) % screen.getHeight(), colorByte)) {
+            regV[0xF] = 1;
         }
     }
-    screen.show();
+    screen.requestShow();
 }
 
 // 0xEXXX
 void CPU::skipIfKeyPressed(int reg) {
-    if (keyboard.getKeyPressed() == regV[reg]) {
+    if (keyboard.isKeyDown(regV[reg])) {
         pc += 2;
     }
 }
 
 void CPU::skipIfKeyNotPressed(int reg) {
-    if (keyboard.getKeyPressed() != regV[reg]) {
+    if (!keyboard.isKeyDown(regV[reg])) {
         pc += 2;
     }
 }
@@ -394,14 +757,29 @@ void CPU::setRegisterToDelayTimer(int reg) {
     regV[reg] = timerDelay;
 }
 
-void CPU::waitForKey(int reg) {
-    byte key = keyboard.getKeyPressed();
-    while (key == NO_KEY_PRESSED) {
-        delay(KEY_DELAY);
-        key = keyboard.getKeyPressed();
+bool CPU::waitForKey(int reg) {
+    if (!waitingForKey) {
+        // Only presses after the instruction count
+        keyboard.clearEvents();
+        waitingForKey = true;
+        waitedKey = NO_KEY_PRESSED;
     }
-
-    regV[reg] = key;
+    KeyEvent event;
+    while (keyboard.getEvent(event)) {
+        if (event.pressed) {
+            if (waitedKey == NO_KEY_PRESSED) {
+                waitedKey = event.key;
+            }
+        } else if (event.key == waitedKey) {
+            regV[reg] = waitedKey;
+            waitingForKey = false;
+            return true;
+        }
+    }
+    // Poll again when run next time
+    pc -= 2;
+    idle = true;
+    return false;
 }
 
 void CPU::setDelayTimer(int reg) {
@@ -426,15 +804,40 @@ void CPU::storeDecimalInMemory(int reg) {
     memory.setByte(regI + 2, ((regV[reg] % 100) % 10));
 }
 
+template <int QUIRKS>
 void CPU::storeRegistersInMemory(int reg) {
     for (int i = 0; i <= reg; i++) {
         memory.setByte(regI + i, regV[i]);
     }
+    if (QUIRKS & QUIRK_INCREMENT_I) {
+        regI += reg + 1;
+    } else if (QUIRKS & QUIRK_INCREMENT_I_BY_X) {
+        regI += reg;
+    }
 }
 
+template <int QUIRKS>
 void CPU::storeMemoryToRegisters(int reg) {
     for (int i = 0; i <= reg; i++) {
         regV[i] = memory.getByte(regI + i);
     }
+    if (QUIRKS & QUIRK_INCREMENT_I) {
+        regI += reg + 1;
+    } else if (QUIRKS & QUIRK_INCREMENT_I_BY_X) {
+        regI += reg;
+    }
 }
 
+// Cores in QuirkProfile order, instantiated with the quirks of each
+#define CORE(name, quirks) {name, quirks, &CPU::executeOpcode<quirks>, &CPU::execute<quirks>, \
+    &CPU::runSwitchCore<quirks>, &CPU::runThreadedCore<quirks>}
+
+const CPU::Core CPU::cores[PROFILE_COUNT] = {
+    CORE("modern", MODERN_QUIRKS),
+    CORE("vip", COSMAC_VIP_QUIRKS),
+    CORE("chip48", CHIP48_QUIRKS),
+    CORE("schip", SCHIP_QUIRKS)
+};
+
+#undef CORE
+
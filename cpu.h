@@ -5,73 +5,319 @@
 #include "screen.h"
 #include "keyboard.h"
 #include "speaker.h"
+#include "decoder.h"
+#include "profiler.h"
+#include "snapshot.h"
+#include "quirks.h"
 
 // Number of registers
 #define NUM_REGISTERS 16
 // Memory location that rom starts at
 #define PC_START 0x200
-// Memory location of begining of stack
-#define STACK_START 0x52
+// Number of return addresses the stack holds, a power of two
+#define STACK_SIZE 16
+
+// Interpreter cores run() can be built with
+#define CPU_DISPATCH_SWITCH 0
+#define CPU_DISPATCH_THREADED 1
+#ifndef CPU_DISPATCH
+#define CPU_DISPATCH CPU_DISPATCH_THREADED
+#endif
+
+/**
+ * Runs instructions of a CPU, with its own interpreter or otherwise.
+ */
+class Engine {
+    public:
+        virtual ~Engine() {}
 
-// Time to wait before checking for key press/release (ms)
-#define KEY_DELAY 30
-// Time for decrementing timers (ms)
-#define TIMER_DELAY 20
+        /**
+         * Runs given number of instructions.
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run, fewer than count if
+         *         the run stopped early. Skipped idle iterations count.
+         */
+        virtual int run(int count) = 0;
+};
 
 /**
  * Emulates CHIP-8 CPU
  */
-class CPU {
-    private:
-        Memory memory;
-        Screen screen;
-        Keyboard keyboard;
-        Speaker speaker;
+class CPU : public Engine {
+    // Host translator working on the registers directly
+    friend class Jit;
 
-        // Pin for for RNG
-        int seed;
+    private:
+        // Devices shared with the rest of the sketch, not owned by CPU
+        Memory &memory;
+        Screen &screen;
+        Keyboard &keyboard;
+        Speaker &speaker;
+
+        // Time source
+        Clock &clock;
+        // Random number generator, seeds CXNN generator
+        Rng &rng;
+        // CXNN generator state, xorshift32, never 0
+        uint32_t randomState;
         
         // Registers
         byte regV[NUM_REGISTERS];
         int regI;
+        // Return addresses, kept apart from RAM so that calls cannot
+        // overwrite the fonts. Deeper calls wrap around.
+        uint16_t stack[STACK_SIZE];
+        // Index of the next free entry of the stack
         int regStack;
 
-        // Timers
-        byte timerDelay;
-        byte timerSound;
+        // Timers, decremented from the timer interrupt
+        volatile byte timerDelay;
+        volatile byte timerSound;
+
+#if CPU_PROFILE
+        // Profile being recorded, NULL if none
+        Profiler *profiler;
+#endif
+
+        // Set while FX0A waits for a key press and release
+        bool waitingForKey;
+        // Key pressed during the wait, NO_KEY_PRESSED until then
+        byte waitedKey;
 
         // Program counter
         int pc = PC_START;
 
-        // State of millis() when last time calculated
-        int lastMillis;
+        // Decoded instructions
+        DecodeCache cache;
+
+        // Number of times each fused sequence was run
+        uint32_t fusionHits[FUSION_COUNT];
+
+        // Sprites drawn
+        unsigned long draws;
+        // Instructions skipped in idle loops
+        unsigned long idleInstructions;
+        // Set when an idle loop is reached, cleared by wasIdle()
+        bool idle;
+
+        /**
+         * Interpreter compiled for the quirks of one profile.
+         */
+        struct Core {
+            const char *name;
+            byte quirks;
+            void (CPU::*executeOpcode)(int opcode);
+            void (CPU::*execute)(const Instruction &instruction);
+            int (CPU::*runSwitch)(int count);
+            int (CPU::*runThreaded)(int count);
+        };
+
+        // Cores by QuirkProfile
+        static const Core cores[PROFILE_COUNT];
+        // Core of the selected profile
+        const Core *core;
+
+        // CPU registers itself with memory, copies are not allowed
+        CPU(const CPU &) = delete;
+        CPU &operator=(const CPU &) = delete;
+
+        // Cores are instantiated for each profile with its quirk flags
+        // as QUIRKS, so that quirks cost no branches when running
+
+        /**
+         * Executes decoded instruction.
+         *
+         * @param instruction Instruction to be executed
+         */
+        template <int QUIRKS> void execute(const Instruction &instruction);
+
+        /**
+         * Decodes and executes opcode, see execute(int).
+         *
+         * @param opcode Opcode to be executed
+         */
+        template <int QUIRKS> void executeOpcode(int opcode);
+
+        /**
+         * Core of runSwitch().
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        template <int QUIRKS> int runSwitchCore(int count);
+
+        /**
+         * Core of runThreaded().
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        template <int QUIRKS> int runThreadedCore(int count);
+
+        // Fused sequences run by runThreaded(), listed in fusions.h.
+        // Each returns number of instructions it executed.
+
+        /**
+         * Reads delay timer, skips if it has reached the value,
+         * otherwise jumps (FX07 3YNN 1NNN). A jump back to itself
+         * is idle until the next timer tick.
+         *
+         * @param instruction Fused instruction
+         * @param count Number of instructions that may be executed
+         * @return Number of instructions executed
+         */
+        template <int QUIRKS> int fusedWaitDelay(const Instruction &instruction, int count);
+
+        /**
+         * Sets register and index register, then draws (6XNN ANNN DXYN).
+         *
+         * @param instruction Fused instruction
+         * @param count Number of instructions that may be executed
+         * @return Number of instructions executed
+         */
+        template <int QUIRKS> int fusedSetDraw(const Instruction &instruction, int count);
+
+        /**
+         * Sets index register, then draws (ANNN DXYN).
+         *
+         * @param instruction Fused instruction
+         * @param count Number of instructions that may be executed
+         * @return Number of instructions executed
+         */
+        template <int QUIRKS> int fusedSetIDraw(const Instruction &instruction, int count);
+
+        /**
+         * Adds value to register, then skips
+         * if register equals value (7XNN 3YNN).
+         *
+         * @param instruction Fused instruction
+         * @param count Number of instructions that may be executed
+         * @return Number of instructions executed
+         */
+        template <int QUIRKS> int fusedCount(const Instruction &instruction, int count);
+
+        /**
+         * Skips if key is (not) pressed, otherwise jumps
+         * (EX9E 1NNN, EXA1 1NNN). A jump back to itself
+         * is idle until the next input event.
+         *
+         * @param instruction Fused instruction
+         * @param count Number of instructions that may be executed
+         * @return Number of instructions executed
+         */
+        template <int QUIRKS> int fusedWaitKey(const Instruction &instruction, int count);
+
+        /**
+         * Skips whole iterations of an idle loop that fit the count.
+         * Loop state repeats each iteration, so the skipped ones would
+         * only burn time.
+         *
+         * @param count Number of instructions that may be executed
+         * @param length Number of instructions in one iteration
+         * @return Number of instructions skipped
+         */
+        int skipIdle(int count, int length);
+
+#ifndef __GNUC__
+        // Handlers called through the table by runThreaded()
+#define OPERATION(op, body) template <int QUIRKS> void handle_##op(const Instruction &instruction);
+#include "operations.h"
+#undef OPERATION
+#endif
         
     public:
         /**
          * Default constructor for the class.
          *
+         * Devices are referenced, not copied, and must outlive the CPU.
+         *
          * @param memory The instance of Memory to be used
          * @param screen The instance of Screen
          * @param keyboard The instance of Keyboard to be used
          * @param speaker The instance of Speaker to be used
-         * @param seed The number of pin to be used for RNG
+         * @param clock The time source to be used
+         * @param rng The random number generator to be used
          */
-        CPU(Memory memory, Screen screen, Keyboard keyboard, Speaker speaker, int seed);
+        CPU(Memory &memory, Screen &screen, Keyboard &keyboard, Speaker &speaker, Clock &clock, Rng &rng);
 
         /**
         * Resets the Arduino.
         */
         void reset();
+
+        /**
+         * Seeds the CXNN random generator, so that runs given the same
+         * seed and keys are repeatable.
+         *
+         * @param seed Seed, 0 is taken as 1
+         */
+        void seedRandom(uint32_t seed);
+
+        /**
+         * Selects the quirks emulated, switching all cores to ones
+         * compiled for them. Called once the ROM is loaded, modern
+         * until then.
+         *
+         * @param profile One of QuirkProfile
+         * @return <code>true</code> if profile exists, <code>false</code> otherwise
+         */
+        bool setQuirkProfile(int profile);
+
+        /**
+         * @return Selected profile, one of QuirkProfile
+         */
+        int getQuirkProfile();
+
+        /**
+         * @return Quirk flags of the selected profile, QUIRK_* bits
+         */
+        byte getQuirks();
+
+        /**
+         * Returns name of given profile.
+         *
+         * @param profile One of QuirkProfile
+         * @return Name of the profile
+         */
+        static const char *getQuirkProfileName(int profile);
+
+        /**
+         * Finds profile by name.
+         *
+         * @param name Name of the profile, as getQuirkProfileName() returns
+         * @return One of QuirkProfile, -1 if there is none of that name
+         */
+        static int findQuirkProfile(const char *name);
         
         /**
-         * Decrements delay and sound timers.
+         * Decrements delay and sound timers by one.
+         * Called once per 60 Hz frame.
          */
         void decrementTimers();
+
+        /**
+         * Writes registers, I, PC, stack, timers, key wait and random
+         * generator (SNAPSHOT_CPU_SIZE bytes).
+         *
+         * @param out Snapshot being written
+         */
+        void saveState(StateWriter &out);
+
+        /**
+         * Reads state written by saveState(). State with a negative
+         * I or PC is refused and leaves the CPU unchanged.
+         *
+         * @param in Snapshot being read
+         * @return <code>true</code> if state was loaded, <code>false</code> otherwise
+         */
+        bool loadState(StateReader &in);
         
         /**
          * Reads command from the memory, executes it
          * and increases program counter so that next
-         * command can be run.
+         * command can be run. Command is taken from the
+         * decode cache when possible.
          */
         void executeNextCommand();
         
@@ -83,9 +329,110 @@ class CPU {
         void execute(int opcode);
 
         /**
-         * Runs the code in loop.
+         * Runs given number of instructions with the core
+         * selected by CPU_DISPATCH. All cores return early
+         * when FX0A starts waiting for a key.
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        int run(int count);
+
+#if CPU_PROFILE
+        /**
+         * Records profile of following runs, replacing the core
+         * selected by CPU_DISPATCH with runProfiled().
+         *
+         * @param profiler Profile to be recorded, NULL to stop
+         */
+        void setProfiler(Profiler *profiler);
+
+        /**
+         * Runs given number of instructions through execute(),
+         * timing each of them. Sequences are not fused.
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        int runProfiled(int count);
+#endif
+
+        /**
+         * Runs given number of instructions, fetching each opcode from
+         * memory and decoding it with execute(int), bypassing the
+         * decode cache. Slow, it is the reference the other cores are
+         * checked against.
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        int runReference(int count);
+
+        /**
+         * Runs given number of instructions, dispatching
+         * through a switch statement.
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        int runSwitch(int count);
+
+        /**
+         * Runs given number of instructions, dispatching through
+         * computed goto labels (GCC) or a handler table.
+         * Sequences listed in fusions.h are run as one instruction
+         * when they fit the count. Results are identical to runSwitch().
+         *
+         * @param count Number of instructions
+         * @return Number of instructions run
+         */
+        int runThreaded(int count);
+
+        /**
+         * Returns value of V register.
+         *
+         * @param reg Number of register
+         * @return Value stored in register
+         */
+        byte getRegister(int reg);
+
+        /**
+         * @return Location of the next instruction
+         */
+        int getPC();
+
+        /**
+         * Returns number of times a fused sequence was run.
+         *
+         * @param fusion One of Fusion
+         * @return Number of runs
          */
-        void run();
+        uint32_t getFusionHits(int fusion);
+
+        /**
+         * Returns whether an idle loop or a key wait was reached
+         * since the last call.
+         * Nothing but a timer tick or an input event can change
+         * the outcome of the loop.
+         *
+         * @return <code>true</code> if CPU is idle, <code>false</code> otherwise
+         */
+        bool wasIdle();
+
+        /**
+         * @return Number of sprites drawn (DXYN)
+         */
+        unsigned long getDraws();
+
+        /**
+         * @return Number of instructions skipped in idle loops
+         */
+        unsigned long getIdleInstructions();
+
+        /**
+         * @return <code>true</code> if FX0A is waiting for a key, <code>false</code> otherwise
+         */
+        bool isWaitingForKey();
 
         // 0x0XXX opcode commands
 
@@ -180,30 +527,30 @@ class CPU {
 
         /**
          * Calculate value of logical or of two registers.
-         * Store result in first.
+         * Store result in first. VF is set to 0 with QUIRK_VF_RESET.
          *
          * @param reg1 First register, stores value
          * @param reg2 Second register
          */
-        void registerOr(int reg1, int reg2);
+        template <int QUIRKS> void registerOr(int reg1, int reg2);
 
         /**
          * Calculate value of logical and of two registers.
-         * Store result in first.
+         * Store result in first. VF is set to 0 with QUIRK_VF_RESET.
          *
          * @param reg1 First register, stores value
          * @param reg2 Second register
          */
-        void registerAnd(int reg1, int reg2);
+        template <int QUIRKS> void registerAnd(int reg1, int reg2);
 
         /**
          * Calculate value of logical xor of two registers.
-         * Store result in first register.
+         * Store result in first register. VF is set to 0 with QUIRK_VF_RESET.
          *
          * @param reg1 First register, stores value
          * @param reg2 Second register
          */
-        void registerXor(int reg1, int reg2);
+        template <int QUIRKS> void registerXor(int reg1, int reg2);
 
         /**
          * Add values of second register to the value of first.
@@ -228,19 +575,21 @@ class CPU {
         void registerSubN(int reg1, int reg2);
 
         /**
-         * Shifts register right by one.
+         * Shifts register right by one, or stores second register
+         * shifted in it with QUIRK_SHIFT_VY.
          * VF is set to the value of the least significant
-         * bit of VX before the shift.
+         * bit shifted out.
          *
-         * @param reg Number of register to be shifted
+         * @param reg1 Number of register to be shifted, stores value
+         * @param reg2 Number of register shifted with QUIRK_SHIFT_VY
          */
-        void registerShiftRight(int reg);
+        template <int QUIRKS> void registerShiftRight(int reg1, int reg2);
 
         /**
-         * Subtracts value of second register from the value of first.
+         * Subtracts value of first register from the value of second.
          * Stores result in first register.
-         * VF is set to 1 when there's a borrow,
-         * and 0 when there isn't.
+         * VF is set to 0 when there's a borrow,
+         * and 1 when there isn't.
          *
          * @param reg1 First register number, stores value
          * @param reg2 Second register number
@@ -248,13 +597,15 @@ class CPU {
         void registerSub(int reg1, int reg2);
 
         /**
-         * Shifts register left by one.
-         * VF is set to the value of the least significant
-         * bit of VX before the shift.
+         * Shifts register left by one, or stores second register
+         * shifted in it with QUIRK_SHIFT_VY.
+         * VF is set to the value of the most significant
+         * bit shifted out.
          *
-         * @param reg Number of register to be shifted
+         * @param reg1 Number of register to be shifted, stores value
+         * @param reg2 Number of register shifted with QUIRK_SHIFT_VY
          */
-        void registerShiftLeft(int reg);
+        template <int QUIRKS> void registerShiftLeft(int reg1, int reg2);
 
         // 0x9XXX opcode commands
 
@@ -280,11 +631,12 @@ class CPU {
 
         /**
          * Jumps to the given location plus the value
-         * of register V0.
+         * of register V0. With QUIRK_JUMP_VX the register
+         * is the one in the high digit of the location (BXNN).
          *
          * @param location Base memory location
          */
-        void jumpToAddressPlusV0(int location);
+        template <int QUIRKS> void jumpToAddressPlusV0(int location);
 
         // 0xCXXX opcode commands
 
@@ -306,12 +658,13 @@ class CPU {
          * I value does not change after the execution of this instruction.
          * As described above, VF is set to 1 if any screen pixels are flipped
          * from set to unset when the sprite is drawn, and to 0 if that does not happen.
+         * Pixels past the edges wrap around, with QUIRK_CLIP they are not drawn.
          *
          * @param reg1 Number of register holding first coordinate
          * @param reg2 Number of register holding second coordinate
          * @param val Value of height
          */
-        void drawSprite(int reg1, int reg2, int val);
+        template <int QUIRKS> void drawSprite(int reg1, int reg2, int val);
 
         // 0xEXXX opcode commands
 
@@ -339,11 +692,15 @@ class CPU {
         void setRegisterToDelayTimer(int reg);
 
         /**
-         * Sets register value to the value of the delay timer.
+         * Waits for a key to be pressed and released, then stores it
+         * in register. Does not block: while waiting, program counter
+         * stays on the instruction, which reads queued key events again
+         * the next time it runs.
          *
          * @param reg Number of register
+         * @return <code>true</code> if key was stored, <code>false</code> if still waiting
          */
-        void waitForKey(int reg);
+        bool waitForKey(int reg);
 
         /**
          * Sets the value of delay timer to the
@@ -391,18 +748,22 @@ class CPU {
         /**
          * Stores values of all V register up to the given one
          * to the memory starting from location in index register.
+         * Index register is advanced with QUIRK_INCREMENT_I and
+         * QUIRK_INCREMENT_I_BY_X.
          *
          * @param reg Number of register
          */
-        void storeRegistersInMemory(int reg);
+        template <int QUIRKS> void storeRegistersInMemory(int reg);
 
         /**
          * Reads values from location stored in index register
          * and stores it in registers uo to given one.
+         * Index register is advanced with QUIRK_INCREMENT_I and
+         * QUIRK_INCREMENT_I_BY_X.
          *
          * @param reg Number of register
          */
-        void storeMemoryToRegisters(int reg);
+        template <int QUIRKS> void storeMemoryToRegisters(int reg);
 };
 
 #endif
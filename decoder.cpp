@@ -0,0 +1,168 @@
+#include "decoder.h"
+
+DecodeCache::DecodeCache(Memory &memory) : memory(memory) {
+    clear();
+    memory.addObserver(this);
+}
+
+void DecodeCache::decode(int opcode, Instruction &instruction) {
+    instruction.x = (opcode & 0x0F00) >> 8;
+    instruction.y = (opcode & 0x00F0) >> 4;
+    instruction.n = opcode & 0x000F;
+    instruction.nn = opcode & 0x00FF;
+    instruction.nnn = opcode & 0x0FFF;
+
+    byte op = OP_NOP;
+    switch ((opcode & 0xF000) >> 12) {
+        case 0x0:
+            switch (opcode & 0x00FF) {
+                case 0xE0: op = OP_CLEAR_SCREEN; break;
+                case 0xEE: op = OP_RETURN; break;
+            }
+            break;
+        case 0x1: op = OP_JUMP; break;
+        case 0x2: op = OP_CALL; break;
+        case 0x3: op = OP_SKIP_EQUAL_VALUE; break;
+        case 0x4: op = OP_SKIP_NOT_EQUAL_VALUE; break;
+        case 0x5: op = OP_SKIP_EQUAL_REGISTER; break;
+        case 0x6: op = OP_SET_VALUE; break;
+        case 0x7: op = OP_ADD_VALUE; break;
+        case 0x8:
+            switch (opcode & 0x000F) {
+                case 0x0: op = OP_MOVE; break;
+                case 0x1: op = OP_OR; break;
+                case 0x2: op = OP_AND; break;
+                case 0x3: op = OP_XOR; break;
+                case 0x4: op = OP_ADD; break;
+                case 0x5: op = OP_SUB_N; break;
+                case 0x6: op = OP_SHIFT_RIGHT; break;
+                case 0x7: op = OP_SUB; break;
+                case 0xE: op = OP_SHIFT_LEFT; break;
+            }
+            break;
+        case 0x9: op = OP_SKIP_NOT_EQUAL_REGISTER; break;
+        case 0xA: op = OP_SET_I; break;
+        case 0xB: op = OP_JUMP_PLUS_V0; break;
+        case 0xC: op = OP_RANDOM; break;
+        case 0xD: op = OP_DRAW; break;
+        case 0xE:
+            switch (opcode & 0x00FF) {
+                case 0x9E: op = OP_SKIP_KEY_PRESSED; break;
+                case 0xA1: op = OP_SKIP_KEY_NOT_PRESSED; break;
+            }
+            break;
+        case 0xF:
+            switch (opcode & 0x00FF) {
+                case 0x07: op = OP_GET_DELAY_TIMER; break;
+                case 0x0A: op = OP_WAIT_FOR_KEY; break;
+                case 0x15: op = OP_SET_DELAY_TIMER; break;
+                case 0x18: op = OP_SET_SOUND_TIMER; break;
+                case 0x1E: op = OP_ADD_TO_I; break;
+                case 0x29: op = OP_LOAD_SPRITE; break;
+                case 0x33: op = OP_STORE_DECIMAL; break;
+                case 0x55: op = OP_STORE_REGISTERS; break;
+                case 0x65: op = OP_LOAD_REGISTERS; break;
+            }
+            break;
+    }
+    instruction.op = op;
+}
+
+void DecodeCache::fuse(int pc, Instruction &entry) {
+    static const byte lengths[] = {
+#define FUSION(op, length, handler) length,
+#include "fusions.h"
+#undef FUSION
+    };
+
+    entry.fused = entry.op;
+    entry.length = 1;
+    if (pc + 2 * MAX_FUSION_LENGTH > MEMORY_SIZE) {
+        return;
+    }
+    Instruction second, third;
+    decode((memory.getByte(pc + 2) << 8) | memory.getByte(pc + 3), second);
+    decode((memory.getByte(pc + 4) << 8) | memory.getByte(pc + 5), third);
+
+    switch (entry.op) {
+        case OP_GET_DELAY_TIMER:
+            if (second.op == OP_SKIP_EQUAL_VALUE && third.op == OP_JUMP) {
+                entry.fused = OP_FUSED_WAIT_DELAY;
+                entry.z = second.x;
+                entry.nn = second.nn;
+                entry.nnn = third.nnn;
+            }
+            break;
+        case OP_SET_VALUE:
+            if (second.op == OP_SET_I && third.op == OP_DRAW) {
+                entry.fused = OP_FUSED_SET_DRAW;
+                entry.nnn = second.nnn;
+                entry.z = third.x;
+                entry.y = third.y;
+                entry.n = third.n;
+            }
+            break;
+        case OP_SET_I:
+            if (second.op == OP_DRAW) {
+                entry.fused = OP_FUSED_SET_I_DRAW;
+                entry.x = second.x;
+                entry.y = second.y;
+                entry.n = second.n;
+            }
+            break;
+        case OP_SKIP_KEY_PRESSED:
+        case OP_SKIP_KEY_NOT_PRESSED:
+            if (second.op == OP_JUMP) {
+                entry.fused = OP_FUSED_WAIT_KEY;
+                entry.nnn = second.nnn;
+            }
+            break;
+        case OP_ADD_VALUE:
+            if (second.op == OP_SKIP_EQUAL_VALUE) {
+                entry.fused = OP_FUSED_COUNT;
+                entry.z = second.x;
+                entry.nnn = second.nn;
+            }
+            break;
+    }
+    if (entry.fused != entry.op) {
+        entry.length = lengths[entry.fused - OP_COUNT];
+    }
+}
+
+const char *DecodeCache::getFusionName(int fusion) {
+    static const char *const names[] = {
+#define FUSION(op, length, handler) #op,
+#include "fusions.h"
+#undef FUSION
+    };
+    return names[fusion - OP_COUNT];
+}
+
+void DecodeCache::invalidate(int location) {
+    Instruction &entry = entries[(location >> 1) & (DECODE_CACHE_SIZE - 1)];
+    if (entry.tag == location) {
+        entry = Instruction();
+        entry.tag = EMPTY_TAG;
+    }
+}
+
+void DecodeCache::clear() {
+    // Whole entries are reset, so that no stale handler is left behind
+    for (int i = 0; i < DECODE_CACHE_SIZE; i++) {
+        entries[i] = Instruction();
+        entries[i].tag = EMPTY_TAG;
+    }
+}
+
+void DecodeCache::onMemoryWrite(int location, int length) {
+    if (length > DECODE_CACHE_SIZE) {
+        clear();
+        return;
+    }
+    // Written bytes can be either half of an instruction,
+    // or part of a sequence fused into an earlier entry
+    for (int i = location - 2 * MAX_FUSION_LENGTH + 1; i < location + length; i++) {
+        invalidate(i);
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef DECODER_H_INCLUDED
+#define DECODER_H_INCLUDED
+
+#include "hal.h"
+#include "memory.h"
+
+// Number of cached instructions, power of two. Whole memory is covered
+// on the host, the board gets a small direct-mapped cache.
+#ifdef ARDUINO
+#define DECODE_CACHE_SIZE 256
+#else
+#define DECODE_CACHE_SIZE (MEMORY_SIZE / 2)
+#endif
+
+// Tag of an empty cache entry, not a location any program counter
+// can take
+#define EMPTY_TAG -1
+
+// Number of instructions in the longest fused sequence
+#define MAX_FUSION_LENGTH 3
+
+/**
+ * Handlers of decoded instructions, listed in operations.h.
+ */
+enum Operation {
+#define OPERATION(op, body) op,
+#include "operations.h"
+#undef OPERATION
+    OP_COUNT
+};
+
+/**
+ * Fused instruction sequences, listed in fusions.h. Numbered right
+ * after Operation, so that both share the handler table of the
+ * threaded core.
+ */
+enum Fusion {
+    FUSION_START = OP_COUNT - 1,
+#define FUSION(op, length, handler) op,
+#include "fusions.h"
+#undef FUSION
+    FUSION_END
+};
+
+// Number of fused sequences
+#define FUSION_COUNT (FUSION_END - OP_COUNT)
+
+/**
+ * Instruction with handler and operands already extracted.
+ */
+struct Instruction {
+    // Location instruction was decoded from, EMPTY_TAG if entry is empty.
+    // As wide as the program counter, which can run past memory.
+    int32_t tag;
+    // Handler, one of Operation
+    byte op;
+    // Handler of the sequence starting here, one of Fusion, or op
+    byte fused;
+    // Number of instructions fused, 1 if not fused
+    byte length;
+    // Operands
+    byte x;
+    byte y;
+    // Extra register of fused sequences
+    byte z;
+    byte n;
+    byte nn;
+    uint16_t nnn;
+};
+
+/**
+ * Cache of decoded instructions indexed by program counter.
+ * Entries are invalidated by writes to memory they were decoded from.
+ */
+class DecodeCache : public MemoryObserver {
+    private:
+        Memory &memory;
+        Instruction entries[DECODE_CACHE_SIZE];
+
+        /**
+         * Drops entry decoded from given location, if cached.
+         *
+         * @param location Location of first byte of instruction
+         */
+        void invalidate(int location);
+
+        /**
+         * Recognises a fused sequence starting at given location
+         * and stores it in the entry decoded from there.
+         *
+         * @param pc Location of the first instruction
+         * @param entry Decoded first instruction
+         */
+        void fuse(int pc, Instruction &entry);
+
+    public:
+        /**
+         * Default constructor. Registers cache as memory observer.
+         *
+         * @param memory Memory instructions are read from
+         */
+        DecodeCache(Memory &memory);
+
+        /**
+         * Splits opcode to handler and operands.
+         *
+         * @param opcode Opcode to be decoded
+         * @param instruction Output
+         */
+        static void decode(int opcode, Instruction &instruction);
+
+        /**
+         * Returns name of given fused sequence.
+         *
+         * @param fusion One of Fusion
+         * @return Name of the sequence
+         */
+        static const char *getFusionName(int fusion);
+
+        /**
+         * Returns decoded instruction at given location,
+         * decoding and fusing it on cache miss.
+         *
+         * @param pc Location of instruction
+         * @return Decoded instruction
+         */
+        inline const Instruction &fetch(int pc) {
+            Instruction &entry = entries[(pc >> 1) & (DECODE_CACHE_SIZE - 1)];
+            if (entry.tag != pc) {
+                decode((memory.getByte(pc) << 8) | memory.getByte(pc + 1), entry);
+                fuse(pc, entry);
+                entry.tag = pc;
+            }
+            return entry;
+        }
+
+        /**
+         * Empties the cache.
+         */
+        void clear();
+
+        void onMemoryWrite(int location, int length);
+};
+
+#endif
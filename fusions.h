@@ -0,0 +1,14 @@
+// Fused instruction sequences, in Fusion order.
+//
+// FUSION(name, length, handler) is defined by the includer. Length is
+// the number of instructions covered, handler is a CPU member template
+// on the quirk flags of the core, taking the fused Instruction and the
+// remaining count, and returning the number of instructions it executed. Fused entries keep operands of
+// the first instruction and carry the rest in fields it does not use.
+// No include guard, file is included once per use.
+
+FUSION(OP_FUSED_WAIT_DELAY, 3, fusedWaitDelay)  // FX07 3YNN 1MMM: x, z = Y, nn, nnn = MMM
+FUSION(OP_FUSED_SET_DRAW, 3, fusedSetDraw)      // 6XNN AMMM DZYN: x, nn, nnn = MMM, z, y, n
+FUSION(OP_FUSED_SET_I_DRAW, 2, fusedSetIDraw)   // ANNN DXYN: nnn, x, y, n
+FUSION(OP_FUSED_COUNT, 2, fusedCount)           // 7XNN 3YMM: x, nn, z = Y, nnn = MM
+FUSION(OP_FUSED_WAIT_KEY, 2, fusedWaitKey)      // EX9E/EXA1 1NNN: op, x, nnn
@@ -0,0 +1,229 @@
+#ifndef HAL_H_INCLUDED
+#define HAL_H_INCLUDED
+
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+/**
+ * Hardware abstraction layer.
+ *
+ * Emulator core (CPU, Memory, Screen, Keyboard, Speaker) talks to the
+ * hardware only through these interfaces. Arduino backend lives in
+ * hal_arduino.h, in-memory Linux backend in host/hal_host.h.
+ */
+
+/**
+ * Monochrome display the screen is drawn to.
+ */
+class Display {
+    public:
+        virtual ~Display() {}
+
+        /**
+         * Initializes the display.
+         */
+        virtual void begin() = 0;
+
+        /**
+         * Writes column bytes of one page (8 pixel rows) straight to the panel,
+         * bypassing the display buffer. Least significant bit is the top row.
+         *
+         * @param page Number of page
+         * @param column First column to be written
+         * @param data Column bytes
+         * @param length Number of columns to be written
+         */
+        virtual void writePage(int page, int column, const byte *data, int length) = 0;
+
+        /**
+         * Clears the display buffer and moves text cursor to the origin.
+         */
+        virtual void clear() = 0;
+
+        /**
+         * Prints given text at the text cursor.
+         *
+         * @param text Text to be printed
+         */
+        virtual void print(const char *text) = 0;
+
+        /**
+         * Prints given number at the text cursor.
+         *
+         * @param number Number to be printed
+         */
+        virtual void print(int number) = 0;
+
+        /**
+         * Sends display buffer (cleared area and text) to the panel.
+         */
+        virtual void update() = 0;
+};
+
+/**
+ * Hexadecimal keypad.
+ */
+class Input {
+    public:
+        virtual ~Input() {}
+
+        /**
+         * Reads raw, not debounced, state of all keys.
+         *
+         * @return Keys held down, bit N set if key N is down
+         */
+        virtual uint16_t scan() = 0;
+};
+
+/**
+ * Buzzer.
+ */
+class Audio {
+    public:
+        virtual ~Audio() {}
+
+        /**
+         * Starts the tone.
+         */
+        virtual void play() = 0;
+
+        /**
+         * Stops the tone.
+         */
+        virtual void mute() = 0;
+};
+
+/**
+ * Storage ROMs are loaded from.
+ */
+class Storage {
+    public:
+        virtual ~Storage() {}
+
+        /**
+         * Initializes the storage.
+         *
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        virtual bool begin() = 0;
+
+        /**
+         * Reads whole file into given buffer.
+         *
+         * @param name Name/path of the file
+         * @param buffer Buffer to read into
+         * @param length Size of the buffer
+         * @return Number of bytes read, -1 if file could not be opened
+         */
+        virtual int read(const char *name, byte *buffer, int length) = 0;
+
+        /**
+         * Writes given buffer to a file, replacing its contents.
+         *
+         * @param name Name/path of the file
+         * @param buffer Bytes to be written
+         * @param length Number of bytes
+         * @return Number of bytes written, -1 if file could not be opened
+         */
+        virtual int write(const char *name, const byte *buffer, int length) = 0;
+};
+
+/**
+ * Time source.
+ */
+class Clock {
+    public:
+        virtual ~Clock() {}
+
+        /**
+         * @return Milliseconds since start
+         */
+        virtual uint32_t millis() = 0;
+
+        /**
+         * @return Microseconds since start
+         */
+        virtual uint32_t micros() = 0;
+
+        /**
+         * Returns free-running cycle counter, or the finest
+         * ticks available. Used for profiling, wraps around.
+         *
+         * @return Cycles since start
+         */
+        virtual uint32_t cycles() = 0;
+
+        /**
+         * Blocks for given time.
+         *
+         * @param ms Time to wait (ms)
+         */
+        virtual void delay(uint32_t ms) = 0;
+};
+
+/**
+ * Periodic timer calling a function at a fixed rate.
+ */
+class FrameTimer {
+    public:
+        virtual ~FrameTimer() {}
+
+        /**
+         * Starts calling given function at given rate.
+         * Function may be called from an interrupt.
+         *
+         * @param hz Number of calls per second
+         * @param callback Function to be called
+         * @param context Value passed to the function
+         */
+        virtual void begin(uint32_t hz, void (*callback)(void *context), void *context) = 0;
+
+        /**
+         * Calls the function for periods that have passed.
+         * Needed only by backends without interrupts.
+         */
+        virtual void poll() = 0;
+
+        /**
+         * Sleeps until the next interrupt or call of the function,
+         * whichever the backend can wait for.
+         */
+        virtual void idle() = 0;
+};
+
+/**
+ * Text output for reports, serial port on the board.
+ */
+class Log {
+    public:
+        virtual ~Log() {}
+
+        /**
+         * Writes given text.
+         *
+         * @param text Text to be written
+         */
+        virtual void print(const char *text) = 0;
+};
+
+/**
+ * Random number generator.
+ */
+class Rng {
+    public:
+        virtual ~Rng() {}
+
+        /**
+         * Seeds the generator.
+         */
+        virtual void seed() = 0;
+
+        /**
+         * @param max Upper bound (exclusive)
+         * @return Random number in range [0, max)
+         */
+        virtual long random(long max) = 0;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "hal_arduino.h"
+
+ArduinoDisplay::ArduinoDisplay(int mosi, int clk, int dc, int reset, int cs) : display(mosi, clk, dc, reset, cs), mosi(mosi), clk(clk), dc(dc), cs(cs) {}
+
+void ArduinoDisplay::begin() {
+    display.begin(SSD1306_SWITCHCAPVCC);
+    display.setTextColor(WHITE);
+}
+
+void ArduinoDisplay::writePage(int page, int column, const byte *data, int length) {
+    display.ssd1306_command(SSD1306_COLUMNADDR);
+    display.ssd1306_command(column);
+    display.ssd1306_command(column + length - 1);
+    display.ssd1306_command(SSD1306_PAGEADDR);
+    display.ssd1306_command(page);
+    display.ssd1306_command(page);
+
+    digitalWrite(cs, HIGH);
+    digitalWrite(dc, HIGH);
+    digitalWrite(cs, LOW);
+    for (int i = 0; i < length; i++) {
+        shiftOut(mosi, clk, MSBFIRST, data[i]);
+    }
+    digitalWrite(cs, HIGH);
+}
+
+void ArduinoDisplay::clear() {
+    display.clearDisplay();
+    display.setCursor(0, 0);
+}
+
+void ArduinoDisplay::print(const char *text) {
+    display.print(text);
+}
+
+void ArduinoDisplay::print(int number) {
+    display.print(number);
+}
+
+void ArduinoDisplay::update() {
+    display.display();
+}
+
+ArduinoInput::ArduinoInput(const char keymap[KEYPAD_ROWS][KEYPAD_COLS], byte rowPins[], byte colPins[]) : keymap(keymap), rowPins(rowPins), colPins(colPins) {
+    for (int r = 0; r < KEYPAD_ROWS; r++) {
+        pinMode(rowPins[r], INPUT_PULLUP);
+    }
+    for (int c = 0; c < KEYPAD_COLS; c++) {
+        pinMode(colPins[c], INPUT);
+    }
+}
+
+uint16_t ArduinoInput::scan() {
+    uint16_t keys = 0;
+    for (int c = 0; c < KEYPAD_COLS; c++) {
+        pinMode(colPins[c], OUTPUT);
+        digitalWrite(colPins[c], LOW);
+        for (int r = 0; r < KEYPAD_ROWS; r++) {
+            if (digitalRead(rowPins[r]) == LOW) {
+                keys |= 1 << keymap[r][c];
+            }
+        }
+        digitalWrite(colPins[c], HIGH);
+        pinMode(colPins[c], INPUT);
+    }
+    return keys;
+}
+
+ArduinoAudio::ArduinoAudio(int pin) : pin(pin) {
+    pinMode(pin, OUTPUT);
+}
+
+void ArduinoAudio::play() {
+    digitalWrite(pin, HIGH);
+}
+
+void ArduinoAudio::mute() {
+    digitalWrite(pin, LOW);
+}
+
+ArduinoStorage::ArduinoStorage(int pinSD) : pinSD(pinSD) {}
+
+bool ArduinoStorage::begin() {
+    return SD.begin(pinSD);
+}
+
+int ArduinoStorage::read(const char *name, byte *buffer, int length) {
+    File file = SD.open(name, FILE_READ);
+    if (!file) {
+        return -1;
+    }
+
+    int i = 0;
+    while (file.available() && i < length) {
+        buffer[i++] = file.read();
+    }
+    file.close();
+    return i;
+}
+
+int ArduinoStorage::write(const char *name, const byte *buffer, int length) {
+    // FILE_WRITE appends, old contents are dropped first
+    SD.remove(name);
+    File file = SD.open(name, FILE_WRITE);
+    if (!file) {
+        return -1;
+    }
+    int written = file.write(buffer, length);
+    file.close();
+    return written;
+}
+
+uint32_t ArduinoClock::millis() {
+    return ::millis();
+}
+
+uint32_t ArduinoClock::micros() {
+    return ::micros();
+}
+
+uint32_t ArduinoClock::cycles() {
+    // SysTick counts CPU cycles down from LOAD once per millisecond
+    uint32_t ms;
+    uint32_t ticks;
+    do {
+        ms = ::millis();
+        ticks = SysTick->VAL;
+    } while (ms != ::millis());
+    return ms * (SysTick->LOAD + 1) + (SysTick->LOAD - ticks);
+}
+
+void ArduinoClock::delay(uint32_t ms) {
+    ::delay(ms);
+}
+
+// Frequency TC4 counts at, GCLK0 (48 MHz) divided by 256
+#define TC_FREQUENCY (F_CPU / 256)
+
+// Function called from TC4 interrupt
+static void (*volatile timerCallback)(void *context) = NULL;
+static void *volatile timerContext = NULL;
+
+/**
+ * Waits for TC4 register writes to synchronize.
+ */
+static inline void tcSync() {
+    while (TC4->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+void ArduinoFrameTimer::begin(uint32_t hz, void (*callback)(void *context), void *context) {
+    timerCallback = callback;
+    timerContext = context;
+
+    GCLK->CLKCTRL.reg = (uint16_t)(GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID(GCM_TC4_TC5));
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+    TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    tcSync();
+    TC4->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV256;
+    tcSync();
+    TC4->COUNT16.CC[0].reg = (uint16_t)(TC_FREQUENCY / hz - 1);
+    tcSync();
+
+    TC4->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+    NVIC_SetPriority(TC4_IRQn, 0);
+    NVIC_EnableIRQ(TC4_IRQn);
+
+    TC4->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    tcSync();
+}
+
+void ArduinoFrameTimer::poll() {}
+
+void ArduinoFrameTimer::idle() {
+    // Woken by TC4, SysTick or any other interrupt
+    __WFI();
+}
+
+void TC4_Handler() {
+    if (TC4->COUNT16.INTFLAG.bit.MC0) {
+        TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+        if (timerCallback) {
+            timerCallback(timerContext);
+        }
+    }
+}
+
+void ArduinoLog::print(const char *text) {
+    Serial.print(text);
+}
+
+ArduinoRng::ArduinoRng(int pin) : pin(pin) {}
+
+void ArduinoRng::seed() {
+    pinMode(pin, INPUT);
+    randomSeed(analogRead(pin));
+}
+
+long ArduinoRng::random(long max) {
+    return ::random(max);
+}
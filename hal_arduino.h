@@ -0,0 +1,161 @@
+#ifndef HAL_ARDUINO_H_INCLUDED
+#define HAL_ARDUINO_H_INCLUDED
+
+#include <Arduino.h>
+#include <SD.h>
+#include <SPI.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+
+#include "hal.h"
+
+#define KEYPAD_ROWS 4
+#define KEYPAD_COLS 4
+
+/**
+ * Adafruit_SSD1306 compatible display connected over software SPI.
+ */
+class ArduinoDisplay : public Display {
+    private:
+        Adafruit_SSD1306 display;
+        // Pins used for writing pages directly
+        int mosi;
+        int clk;
+        int dc;
+        int cs;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param mosi Number of pin screen MOSI is connected to
+         * @param clk Number of pin screen CLK is connected to
+         * @param dc Number of pin screen DC is connected to
+         * @param reset Number of pin screen RESET is connected to
+         * @param cs Number of pin screen CS is connected to
+         */
+        ArduinoDisplay(int mosi, int clk, int dc, int reset, int cs);
+
+        void begin();
+        void writePage(int page, int column, const byte *data, int length);
+        void clear();
+        void print(const char *text);
+        void print(int number);
+        void update();
+};
+
+/**
+ * 4x4 matrix keypad. Columns are driven low one at a time,
+ * rows are read with pull-ups.
+ */
+class ArduinoInput : public Input {
+    private:
+        // Keys assigned to matrix positions
+        const char (*keymap)[KEYPAD_COLS];
+        byte *rowPins;
+        byte *colPins;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param keymap Keys (0-F) assigned to matrix positions
+         * @param rowPins Pins rows are connected to
+         * @param colPins Pins columns are connected to
+         */
+        ArduinoInput(const char keymap[KEYPAD_ROWS][KEYPAD_COLS], byte rowPins[], byte colPins[]);
+
+        uint16_t scan();
+};
+
+/**
+ * Piezo buzzer on a digital pin.
+ */
+class ArduinoAudio : public Audio {
+    private:
+        // Number of pin buzzer is connected to
+        int pin;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param pin Number of pin buzzer is connected to
+         */
+        ArduinoAudio(int pin);
+
+        void play();
+        void mute();
+};
+
+/**
+ * SD card.
+ */
+class ArduinoStorage : public Storage {
+    private:
+        // Number of pin SD card is connected to
+        int pinSD;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param pinSD Number of pin SD card is connected to
+         */
+        ArduinoStorage(int pinSD);
+
+        bool begin();
+        int read(const char *name, byte *buffer, int length);
+        int write(const char *name, const byte *buffer, int length);
+};
+
+/**
+ * Arduino millis()/delay().
+ */
+class ArduinoClock : public Clock {
+    public:
+        uint32_t millis();
+        uint32_t micros();
+        uint32_t cycles();
+        void delay(uint32_t ms);
+};
+
+/**
+ * SAMD21 TC4 peripheral firing an interrupt at a fixed rate.
+ */
+class ArduinoFrameTimer : public FrameTimer {
+    public:
+        void begin(uint32_t hz, void (*callback)(void *context), void *context);
+        void poll();
+        void idle();
+};
+
+/**
+ * Serial port, opened by the sketch.
+ */
+class ArduinoLog : public Log {
+    public:
+        void print(const char *text);
+};
+
+/**
+ * Arduino random(), seeded from a floating analog pin.
+ */
+class ArduinoRng : public Rng {
+    private:
+        // Pin for for RNG
+        int pin;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param pin The number of pin to be used for RNG
+         */
+        ArduinoRng(int pin);
+
+        void seed();
+        long random(long max);
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "machine.h"
+#include "lockstep.h"
+#include "roms.h"
+#include "work_pool.h"
+
+// Instances run per ROM when count is not given
+#define DEFAULT_INSTANCES 1000
+// Frames each instance runs when not given
+#define DEFAULT_FRAMES 600
+// Instructions per frame when not given
+#define BATCH_INSTRUCTIONS_PER_FRAME 20
+
+// Frames between two scripted key presses
+#define SCRIPT_PERIOD 12
+// Frames a scripted key is held
+#define SCRIPT_HOLD 5
+
+/**
+ * ROM contents shared by all instances running it.
+ */
+struct Rom {
+    std::string name;
+    std::vector<byte> data;
+};
+
+/**
+ * Outcome of one instance.
+ */
+struct Outcome {
+    uint32_t hash;
+    unsigned long instructions;
+    unsigned long draws;
+    unsigned long idleFrames;
+    int pc;
+    bool waitingForKey;
+};
+
+/**
+ * Keypad input derived from the instance seed: every SCRIPT_PERIOD
+ * frames a pseudo random key is pressed and held for SCRIPT_HOLD frames.
+ */
+class InputScript {
+    private:
+        // Xorshift state
+        uint32_t state;
+        // Keys held
+        uint16_t keys;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param seed Seed of the instance, not 0
+         */
+        InputScript(uint32_t seed) : state(seed), keys(0) {}
+
+        /**
+         * Returns keys held in given frame. Frames are asked for in order.
+         *
+         * @param frame Number of frame about to run
+         * @return Bit N set if key N is held
+         */
+        uint16_t next(long frame) {
+            long step = frame % SCRIPT_PERIOD;
+            if (step == 0) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                keys = 1 << (state & 0xF);
+            } else if (step == SCRIPT_HOLD) {
+                keys = 0;
+            }
+            return keys;
+        }
+
+        /**
+         * Presses and releases keys of a keypad for given frame.
+         *
+         * @param input Keypad to be driven
+         * @param frame Number of frame about to run
+         */
+        void apply(HostInput &input, long frame) {
+            uint16_t held = next(frame);
+            for (int key = 0; key < NUM_KEYS; key++) {
+                if ((held >> key) & 1) {
+                    input.press((char)key);
+                } else {
+                    input.release((char)key);
+                }
+            }
+        }
+};
+
+/**
+ * Reads a ROM file or finds a built in ROM.
+ *
+ * @param name Name of a built in ROM or path of a ROM file
+ * @param rom Output
+ * @return <code>true</code> if ROM was found, <code>false</code> otherwise
+ */
+static bool readRom(const char *name, Rom &rom) {
+    rom.name = name;
+    const BuiltinRom *builtin = findBuiltinRom(name);
+    if (builtin) {
+        rom.data.assign(builtin->data, builtin->data + builtin->length);
+        return true;
+    }
+    FILE *file = fopen(name, "rb");
+    if (!file) {
+        return false;
+    }
+    byte buffer[MEMORY_SIZE - ROM_OFFSET];
+    size_t length = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+    rom.data.assign(buffer, buffer + length);
+    return true;
+}
+
+/**
+ * Runs one instance from reset.
+ *
+ * @param rom ROM to be run
+ * @param seed Seed of the random generator and the input script
+ * @param frames Frames to run
+ * @param instructionsPerFrame Instructions per frame
+ * @param outcome Output
+ */
+static void runInstance(const Rom &rom, uint32_t seed, long frames, int instructionsPerFrame, Outcome &outcome) {
+    Machine *machine = new Machine(instructionsPerFrame, seed);
+    machine->loadRom(rom.data.data(), (int)rom.data.size());
+    InputScript script(seed);
+    for (long frame = 0; frame < frames; frame++) {
+        script.apply(machine->input, frame);
+        machine->runFrame();
+    }
+    outcome.hash = machine->hashScreen();
+    outcome.instructions = machine->scheduler.getInstructions();
+    outcome.draws = machine->cpu.getDraws();
+    outcome.idleFrames = machine->scheduler.getIdleFrames();
+    outcome.pc = machine->cpu.getPC();
+    outcome.waitingForKey = machine->cpu.isWaitingForKey();
+    delete machine;
+}
+
+/**
+ * Runs consecutive instances of a ROM from reset as lanes of a Lockstep.
+ *
+ * @param rom ROM to be run
+ * @param first Index of the first instance
+ * @param count Number of instances
+ * @param frames Frames to run
+ * @param instructionsPerFrame Instructions per frame
+ * @param outcomes Output, count entries
+ * @param steps Output, instructions run in groups and alone are added
+ */
+static void runLanes(const Rom &rom, int first, int count, long frames, int instructionsPerFrame, Outcome *outcomes,
+    unsigned long steps[2]) {
+    Lockstep *lockstep = new Lockstep(count, instructionsPerFrame);
+    lockstep->loadRom(rom.data.data(), (int)rom.data.size());
+    std::vector<InputScript> scripts;
+    for (int lane = 0; lane < count; lane++) {
+        lockstep->seed(lane, first + lane + 1);
+        scripts.push_back(InputScript(first + lane + 1));
+    }
+    for (long frame = 0; frame < frames; frame++) {
+        for (int lane = 0; lane < count; lane++) {
+            lockstep->setKeys(lane, scripts[lane].next(frame));
+        }
+        lockstep->runFrame();
+    }
+    for (int lane = 0; lane < count; lane++) {
+        Outcome &outcome = outcomes[lane];
+        outcome.hash = lockstep->hashScreen(lane);
+        outcome.instructions = lockstep->getInstructions(lane);
+        outcome.draws = lockstep->getDraws(lane);
+        outcome.idleFrames = 0;
+        outcome.pc = lockstep->getPC(lane);
+        outcome.waitingForKey = lockstep->isWaitingForKey(lane);
+    }
+    steps[0] += lockstep->getGroupSteps();
+    steps[1] += lockstep->getLaneSteps();
+    delete lockstep;
+}
+
+/**
+ * Batch runner for compatibility sweeps.
+ *
+ * Runs many independent instances of each ROM headless on a work-stealing
+ * thread pool. Instance N of a ROM is seeded with N + 1, which seeds both
+ * CXNN and its scripted input. Writes one JSON object per instance, in
+ * ROM and instance order, with the screen hash and counters, and a
+ * summary to stderr.
+ *
+ * With -l, each job runs that many instances of a ROM as lanes of a
+ * Lockstep instead of one Machine each. Results are the same, except
+ * that idle frames are not detected and are left out.
+ *
+ * Usage: chipino8_batch [-n instances] [-f frames] [-i instructions per frame]
+ *                       [-t threads] [-l lanes] [-o output] [rom...]
+ */
+int main(int argc, char **argv) {
+    int instances = DEFAULT_INSTANCES;
+    long frames = DEFAULT_FRAMES;
+    int instructionsPerFrame = BATCH_INSTRUCTIONS_PER_FRAME;
+    int threads = 0;
+    int lanes = 0;
+    const char *outputName = NULL;
+    std::vector<const char *> romNames;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-n") == 0 && hasValue) {
+            instances = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && hasValue) {
+            frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && hasValue) {
+            instructionsPerFrame = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && hasValue) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && hasValue) {
+            lanes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+            outputName = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: chipino8_batch [-n instances] [-f frames] [-i instructions per frame] "
+                "[-t threads] [-l lanes] [-o output] [rom...]\n");
+            return 2;
+        } else {
+            romNames.push_back(argv[i]);
+        }
+    }
+    if (romNames.empty()) {
+        for (int i = 0; i < BUILTIN_ROM_COUNT; i++) {
+            romNames.push_back(builtinRoms[i].name);
+        }
+    }
+    if (instances < 1) {
+        instances = 1;
+    }
+
+    std::vector<Rom> roms(romNames.size());
+    for (size_t i = 0; i < romNames.size(); i++) {
+        if (!readRom(romNames[i], roms[i])) {
+            fprintf(stderr, "error loading ROM %s\n", romNames[i]);
+            return 1;
+        }
+    }
+
+    int count = (int)roms.size() * instances;
+    std::vector<Outcome> outcomes(count);
+    WorkPool pool(threads);
+    // Instructions run in lockstep groups and lane by lane, per worker
+    std::vector<unsigned long> steps(pool.getNumWorkers() * 2);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (lanes > 0) {
+        int batches = (instances + lanes - 1) / lanes;
+        pool.run((int)roms.size() * batches, [&](int job, int worker) {
+            int rom = job / batches;
+            int first = job % batches * lanes;
+            int size = instances - first < lanes ? instances - first : lanes;
+            runLanes(roms[rom], first, size, frames, instructionsPerFrame, &outcomes[rom * instances + first], &steps[worker * 2]);
+        });
+    } else {
+        pool.run(count, [&](int job, int) {
+            runInstance(roms[job / instances], job % instances + 1, frames, instructionsPerFrame, outcomes[job]);
+        });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FILE *out = stdout;
+    if (outputName) {
+        out = fopen(outputName, "w");
+        if (!out) {
+            fprintf(stderr, "error writing %s\n", outputName);
+            return 1;
+        }
+    }
+    unsigned long instructions = 0;
+    for (int job = 0; job < count; job++) {
+        const Outcome &o = outcomes[job];
+        fprintf(out, "{\"rom\": \"%s\", \"instance\": %d, \"hash\": \"%08X\", \"instructions\": %lu, \"draws\": %lu, ",
+            roms[job / instances].name.c_str(), job % instances, (unsigned)o.hash, o.instructions, o.draws);
+        if (lanes <= 0) {
+            fprintf(out, "\"idle_frames\": %lu, ", o.idleFrames);
+        }
+        fprintf(out, "\"pc\": \"%03X\", \"waiting_for_key\": %s}\n", o.pc, o.waitingForKey ? "true" : "false");
+        instructions += o.instructions;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%d instances, %d threads, %.3f s, %.0f instances/s, %.0f instructions/s\n",
+        count, pool.getNumWorkers(), seconds, seconds > 0 ? count / seconds : 0.0, seconds > 0 ? instructions / seconds : 0.0);
+    if (lanes > 0) {
+        unsigned long grouped = 0;
+        unsigned long alone = 0;
+        for (int i = 0; i < pool.getNumWorkers(); i++) {
+            grouped += steps[i * 2];
+            alone += steps[i * 2 + 1];
+        }
+        fprintf(stderr, "lockstep: %d lanes, %s, %lu instructions in groups, %lu alone\n",
+            lanes, Lockstep::hasAvx2() ? "AVX2" : "scalar", grouped, alone);
+    }
+    for (int i = 0; i < pool.getNumWorkers(); i++) {
+        fprintf(stderr, "  thread %d: %lu instances, %lu steals\n", i, pool.getJobsDone(i), pool.getSteals(i));
+    }
+    return 0;
+}
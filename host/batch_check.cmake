@@ -0,0 +1,22 @@
+# Runs the batch runner on the built in ROMs with one Machine per instance
+# and with lockstep lanes, and fails unless both report the same outcomes.
+# Idle frames are only detected by Machine and are left out.
+#
+# Usage: cmake -DBATCH=<chipino8_batch> -P batch_check.cmake
+
+execute_process(COMMAND ${BATCH} -n 8 -f 120 -t 1
+    OUTPUT_VARIABLE machine RESULT_VARIABLE status ERROR_QUIET)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "chipino8_batch failed: ${status}")
+endif()
+execute_process(COMMAND ${BATCH} -n 8 -f 120 -t 1 -l 3
+    OUTPUT_VARIABLE lanes RESULT_VARIABLE status ERROR_QUIET)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "chipino8_batch -l failed: ${status}")
+endif()
+
+string(REGEX REPLACE "\"idle_frames\": [0-9]+, " "" machine "${machine}")
+if(NOT machine STREQUAL lanes)
+    message(FATAL_ERROR "lockstep lanes differ from Machine\nMachine:\n${machine}\nLanes:\n${lanes}")
+endif()
+message(STATUS "lockstep lanes match Machine")
@@ -0,0 +1,314 @@
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "machine.h"
+#include "roms.h"
+
+// Frames each ROM runs when count is not given
+#define DEFAULT_FRAMES 6000
+// Instructions per frame when not given
+#define BENCH_INSTRUCTIONS_PER_FRAME 500
+// Runs of each ROM, the fastest one is reported
+#define DEFAULT_REPEAT 3
+// Shortest timed run (s), faster ROMs are run several times per run
+#define MIN_RUN_TIME 0.2
+// Allowed slowdown against the baseline (%)
+#define DEFAULT_TOLERANCE 10
+
+// Scripted input: key N is pressed at frame N * KEY_PERIOD modulo
+// NUM_KEYS * KEY_PERIOD and held for KEY_HOLD frames
+#define KEY_PERIOD 20
+#define KEY_HOLD 8
+
+/**
+ * Measured run of one ROM.
+ */
+struct Result {
+    std::string name;
+    unsigned long instructions;
+    unsigned long frames;
+    unsigned long draws;
+    double seconds;
+    long peakRss;
+};
+
+/**
+ * @return Peak resident set size of the process (KiB)
+ */
+static long peakRss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Presses and releases keys for given frame.
+ *
+ * @param input Keypad to be driven
+ * @param frame Number of frame about to run
+ */
+static void script(HostInput &input, long frame) {
+    long step = frame % (NUM_KEYS * KEY_PERIOD);
+    char key = (char)(step / KEY_PERIOD);
+    if (step % KEY_PERIOD == 0) {
+        input.press(key);
+    } else if (step % KEY_PERIOD == KEY_HOLD) {
+        input.release(key);
+    }
+}
+
+/**
+ * Runs a ROM the given number of times and keeps the fastest run.
+ * A run repeats the ROM from reset until it took MIN_RUN_TIME, the
+ * time reported is that of a single pass.
+ *
+ * @param name Name reported
+ * @param rom Built in ROM, NULL to load file with the name
+ * @param frames Frames to run
+ * @param instructionsPerFrame Instructions per frame
+ * @param repeat Number of runs
+ * @param result Output
+ * @return <code>true</code> if ROM was loaded, <code>false</code> otherwise
+ */
+static bool measure(const char *name, const BuiltinRom *rom, long frames, int instructionsPerFrame, int repeat, Result &result) {
+    result.name = name;
+    result.seconds = -1;
+    for (int run = 0; run < repeat; run++) {
+        double seconds = 0;
+        int passes = 0;
+        while (seconds < MIN_RUN_TIME) {
+            Machine *machine = new Machine(instructionsPerFrame);
+            bool loaded = rom ? machine->loadRom(rom->data, rom->length) : machine->loadRom(name);
+            if (!loaded) {
+                delete machine;
+                return false;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (long frame = 0; frame < frames; frame++) {
+                script(machine->input, frame);
+                machine->runFrame();
+            }
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            passes++;
+
+            // Every pass runs the same, counters of the last one are kept
+            result.instructions = machine->scheduler.getInstructions();
+            result.frames = machine->scheduler.getFrames();
+            result.draws = machine->cpu.getDraws();
+            delete machine;
+        }
+        seconds /= passes;
+        if (result.seconds < 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+    }
+    result.peakRss = peakRss();
+    return true;
+}
+
+/**
+ * @param count Number of events
+ * @param seconds Time they took
+ * @return Events per second
+ */
+static double rate(unsigned long count, double seconds) {
+    return seconds > 0 ? count / seconds : 0.0;
+}
+
+/**
+ * Writes results as JSON.
+ *
+ * @param out Stream to write to
+ * @param results Results
+ * @param frames Frames run per ROM
+ * @param instructionsPerFrame Instructions per frame
+ */
+static void writeJson(FILE *out, const std::vector<Result> &results, long frames, int instructionsPerFrame) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"frames\": %ld,\n", frames);
+    fprintf(out, "  \"instructions_per_frame\": %d,\n", instructionsPerFrame);
+    fprintf(out, "  \"roms\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"instructions\": %lu, \"frames\": %lu, \"draws\": %lu, \"seconds\": %.6f, "
+            "\"instructions_per_second\": %.0f, \"frames_per_second\": %.0f, \"frame_time_us\": %.3f, "
+            "\"dxyn_per_second\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+            r.name.c_str(), r.instructions, r.frames, r.draws, r.seconds,
+            rate(r.instructions, r.seconds), rate(r.frames, r.seconds), r.frames ? r.seconds * 1e6 / r.frames : 0.0,
+            rate(r.draws, r.seconds), r.peakRss,
+            i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+    fprintf(out, "  \"peak_rss_kb\": %ld\n", peakRss());
+    fprintf(out, "}\n");
+}
+
+/**
+ * Reads a number following a key in a JSON object.
+ *
+ * @param object Text of the object
+ * @param key Key, with quotes
+ * @param value Output
+ * @return <code>true</code> if key was found, <code>false</code> otherwise
+ */
+static bool readNumber(const std::string &object, const char *key, double &value) {
+    size_t at = object.find(key);
+    if (at == std::string::npos) {
+        return false;
+    }
+    at = object.find(':', at);
+    if (at == std::string::npos) {
+        return false;
+    }
+    value = strtod(object.c_str() + at + 1, NULL);
+    return true;
+}
+
+/**
+ * Compares results with a baseline written by this program. Only
+ * ROMs present in both are compared, on instructions per second.
+ *
+ * @param name Path of the baseline
+ * @param results Results
+ * @param tolerance Allowed slowdown (%)
+ * @return Number of regressions, -1 if baseline could not be read
+ */
+static int compare(const char *name, const std::vector<Result> &results, double tolerance) {
+    FILE *file = fopen(name, "r");
+    if (!file) {
+        return -1;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, length);
+    }
+    fclose(file);
+
+    int regressions = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        std::string key = "\"name\": \"" + r.name + "\"";
+        size_t at = text.find(key);
+        if (at == std::string::npos) {
+            continue;
+        }
+        std::string object = text.substr(at, text.find('}', at) - at);
+        double baseline;
+        if (!readNumber(object, "\"instructions_per_second\"", baseline) || baseline <= 0) {
+            continue;
+        }
+        double current = rate(r.instructions, r.seconds);
+        double change = 100.0 * (current - baseline) / baseline;
+        fprintf(stderr, "%-20s %14.0f/s baseline %14.0f/s %+6.1f%%\n", r.name.c_str(), current, baseline, change);
+        if (change < -tolerance) {
+            fprintf(stderr, "regression: %s is %.1f%% slower than baseline\n", r.name.c_str(), -change);
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+/**
+ * Prints command line usage.
+ */
+static void usage() {
+    fprintf(stderr, "usage: chipino8_bench [-f frames] [-i instructions per frame] [-r repeat] "
+        "[-o output] [-b baseline] [-t tolerance %%] [rom...]\n");
+}
+
+/**
+ * Benchmark suite.
+ *
+ * Runs built in ROMs and given ROM files headless for a fixed number
+ * of frames with scripted input, and writes instructions, frames and
+ * DXYN per second, mean frame time and peak RSS as JSON. Optionally fails when
+ * throughput drops below a stored baseline.
+ *
+ * Usage: chipino8_bench [-f frames] [-i instructions per frame] [-r repeat]
+ *                       [-o output] [-b baseline] [-t tolerance %] [rom...]
+ */
+int main(int argc, char **argv) {
+    long frames = DEFAULT_FRAMES;
+    int instructionsPerFrame = BENCH_INSTRUCTIONS_PER_FRAME;
+    int repeat = DEFAULT_REPEAT;
+    const char *outputName = NULL;
+    const char *baselineName = NULL;
+    double tolerance = DEFAULT_TOLERANCE;
+    std::vector<const char *> romNames;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-f") == 0 && hasValue) {
+            frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && hasValue) {
+            instructionsPerFrame = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && hasValue) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+            outputName = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && hasValue) {
+            baselineName = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && hasValue) {
+            tolerance = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            romNames.push_back(argv[i]);
+        }
+    }
+    // A run of no frames never reaches MIN_RUN_TIME
+    if (frames < 1 || repeat < 1) {
+        usage();
+        return 2;
+    }
+
+    std::vector<Result> results;
+    for (int i = 0; i < BUILTIN_ROM_COUNT; i++) {
+        Result result;
+        measure(builtinRoms[i].name, &builtinRoms[i], frames, instructionsPerFrame, repeat, result);
+        results.push_back(result);
+    }
+    for (size_t i = 0; i < romNames.size(); i++) {
+        Result result;
+        if (!measure(romNames[i], NULL, frames, instructionsPerFrame, repeat, result)) {
+            fprintf(stderr, "error loading ROM %s\n", romNames[i]);
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    FILE *out = stdout;
+    if (outputName) {
+        out = fopen(outputName, "w");
+        if (!out) {
+            fprintf(stderr, "error writing %s\n", outputName);
+            return 1;
+        }
+    }
+    writeJson(out, results, frames, instructionsPerFrame);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    if (baselineName) {
+        int regressions = compare(baselineName, results, tolerance);
+        if (regressions < 0) {
+            fprintf(stderr, "error reading baseline %s\n", baselineName);
+            return 1;
+        }
+        if (regressions > 0) {
+            return 3;
+        }
+    }
+    return 0;
+}
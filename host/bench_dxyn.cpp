@@ -0,0 +1,67 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "hal_host.h"
+#include "../cpu.h"
+#include "../presenter.h"
+
+// Sprites drawn when count is not given
+#define DEFAULT_SPRITES 2000000
+// Location sprite data is placed at
+#define SPRITE_LOCATION 0x300
+// Sprites drawn between two presented frames
+#define SPRITES_PER_FRAME 30
+
+/**
+ * Microbenchmark of DXYN throughput.
+ *
+ * Draws 8x15 sprites at positions walking over the whole screen,
+ * including ones wrapping around the edges. Screen is presented
+ * once every SPRITES_PER_FRAME sprites.
+ *
+ * Usage: chipino8_bench_dxyn [sprites]
+ */
+int main(int argc, char **argv) {
+    long sprites = argc > 1 ? atol(argv[1]) : DEFAULT_SPRITES;
+
+    static byte mem[MEMORY_SIZE];
+    HostDisplay display;
+    HostInput input;
+    HostStorage storage;
+    HostAudio audio;
+    HostClock clock;
+    HostRng rng;
+
+    Keyboard keyboard(input, clock, 0);
+    Screen screen(display, 2);
+    Memory memory(storage, mem);
+    Speaker speaker(audio);
+    CPU cpu(memory, screen, keyboard, speaker, clock, rng);
+    Presenter presenter(screen, clock);
+
+    for (int i = 0; i < 15; i++) {
+        memory.setByte(SPRITE_LOCATION + i, (byte)(0xA5 ^ (i * 0x1F)));
+    }
+    cpu.execute(0xA000 | SPRITE_LOCATION);
+
+    unsigned collisions = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < sprites; i++) {
+        cpu.execute(0x6000 | (int)((i * 7) & 0xFF));
+        cpu.execute(0x6100 | (int)((i * 3) & 0xFF));
+        cpu.execute(0xD01F);
+        collisions += cpu.getRegister(0xF);
+        if (i % SPRITES_PER_FRAME == SPRITES_PER_FRAME - 1) {
+            presenter.tick();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("sprites: %ld\n", sprites);
+    printf("collisions: %u\n", collisions);
+    printf("seconds: %.6f\n", seconds);
+    printf("DXYN/s: %.0f\n", seconds > 0 ? sprites / seconds : 0.0);
+    printf("panel bytes/DXYN: %.1f\n", sprites > 0 ? (double)display.getBytesWritten() / sprites : 0.0);
+    return 0;
+}
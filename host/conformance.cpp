@@ -0,0 +1,379 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "machine.h"
+#include "../snapshot.h"
+#ifdef CHIPINO8_JIT
+#include "jit.h"
+#endif
+
+// Frames each test ROM runs
+#define CONFORMANCE_FRAMES 60
+// Instructions per frame, so that every ROM runs a fixed count
+#define CONFORMANCE_INSTRUCTIONS_PER_FRAME 500
+
+/**
+ * Key held by a test script from one frame until another.
+ */
+struct ScriptedKey {
+    char key;
+    int pressFrame;
+    int releaseFrame;
+};
+
+/**
+ * Test ROM with its input and the hash of the screen it must leave.
+ */
+struct ConformanceTest {
+    const char *name;
+    const byte *data;
+    int length;
+    const ScriptedKey *keys;
+    int keyCount;
+    // Machine::hashScreen() after CONFORMANCE_FRAMES frames, by QuirkProfile
+    uint32_t goldens[PROFILE_COUNT];
+};
+
+// Test ROMs are self-checking: each group of checks counts the ones
+// passed in VC and draws the count as a digit. VA and VB hold the
+// position of the next digit, ROMs halt on a jump to itself.
+// Screen hashes pin the digits, and the pixels DXYN left around them.
+
+// Instructions other than the flag setting ones. Each digit is the number
+// of checks passed for a group of instructions, in the order below:
+// 2 4 2 2 2 2 2 4 3 3 2 1, then 3 on the second row.
+static const byte OPCODES[] = {
+    // Digits are drawn from (1, 1), VA and VB hold the position
+    0x6A, 0x01, 0x6B, 0x01,
+    // 6XNN 7XNN: 0xFE + 3 wraps to 1, VF untouched
+    0x6C, 0x00, 0x6F, 0x05, 0x60, 0xFE, 0x70, 0x03, 0x40, 0x01, 0x7C, 0x01, 0x4F, 0x05, 0x7C, 0x01,
+    0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XY0 8XY1 8XY2 8XY3: 0x3C and 0xA5
+    0x6C, 0x00, 0x61, 0x3C, 0x62, 0xA5, 0x83, 0x10, 0x84, 0x10, 0x84, 0x21, 0x85, 0x10, 0x85, 0x22,
+    0x86, 0x10, 0x86, 0x23, 0x43, 0x3C, 0x7C, 0x01, 0x44, 0xBD, 0x7C, 0x01, 0x45, 0x24, 0x7C, 0x01,
+    0x46, 0x99, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 3XNN: skips when equal, not otherwise
+    0x6C, 0x00, 0x60, 0x05, 0x6D, 0x01, 0x30, 0x05, 0x6D, 0x00, 0x4D, 0x01, 0x7C, 0x01, 0x6D, 0x01,
+    0x30, 0x06, 0x6D, 0x00, 0x4D, 0x00, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 4XNN: skips when not equal, not otherwise
+    0x6C, 0x00, 0x6D, 0x01, 0x40, 0x06, 0x6D, 0x00, 0x4D, 0x01, 0x7C, 0x01, 0x6D, 0x01, 0x40, 0x05,
+    0x6D, 0x00, 0x4D, 0x00, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 5XY0: skips when equal, not otherwise
+    0x6C, 0x00, 0x61, 0x05, 0x62, 0x06, 0x6D, 0x01, 0x50, 0x10, 0x6D, 0x00, 0x4D, 0x01, 0x7C, 0x01,
+    0x6D, 0x01, 0x50, 0x20, 0x6D, 0x00, 0x4D, 0x00, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 9XY0: skips when not equal, not otherwise
+    0x6C, 0x00, 0x6D, 0x01, 0x90, 0x20, 0x6D, 0x00, 0x4D, 0x01, 0x7C, 0x01, 0x6D, 0x01, 0x90, 0x10,
+    0x6D, 0x00, 0x4D, 0x00, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 1NNN BNNN: jump over an instruction, jump to NNN + V0 (V2 = V0, so that BXNN lands there too)
+    0x6C, 0x00, 0x6D, 0x00, 0x12, 0xC2, 0x6D, 0x01, 0x4D, 0x00, 0x7C, 0x01, 0x60, 0x04, 0x62, 0x04,
+    0xB2, 0xCC, 0x6D, 0x01, 0x6D, 0x02, 0x4D, 0x00, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 2NNN 00EE: three nested calls, 13 recursive calls, font at 0x52 intact
+    0x6C, 0x00, 0x6D, 0x00, 0x23, 0xA6, 0x4D, 0x03, 0x7C, 0x01, 0x60, 0x0C, 0x6D, 0x00, 0x23, 0xB6,
+    0x4D, 0x0C, 0x7C, 0x01, 0xA0, 0x52, 0xF1, 0x65, 0x40, 0xE7, 0x7C, 0x01, 0x41, 0xC3, 0x7C, 0x01,
+    0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // ANNN FX33 FX65: BCD of 123
+    0x6C, 0x00, 0xAE, 0x00, 0x60, 0x7B, 0xF0, 0x33, 0xF2, 0x65, 0x40, 0x01, 0x7C, 0x01, 0x41, 0x02,
+    0x7C, 0x01, 0x42, 0x03, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // FX55 FX1E FX65: store at 0xE10, load back through 0xE00 + 0x10
+    0x6C, 0x00, 0x60, 0x07, 0x61, 0x08, 0x62, 0x09, 0xAE, 0x10, 0xF2, 0x55, 0x60, 0x00, 0x61, 0x00,
+    0x62, 0x00, 0xAE, 0x00, 0x63, 0x10, 0xF3, 0x1E, 0xF2, 0x65, 0x40, 0x07, 0x7C, 0x01, 0x41, 0x08,
+    0x7C, 0x01, 0x42, 0x09, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // CXNN: results are masked by NN
+    0x6C, 0x00, 0xC0, 0x00, 0x40, 0x00, 0x7C, 0x01, 0xC1, 0x0F, 0x62, 0x70, 0x81, 0x22, 0x41, 0x00,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // FX15 FX07 FX18: delay timer counts down to 0
+    0x6C, 0x00, 0x60, 0x03, 0xF0, 0x15, 0xF0, 0x18, 0xF1, 0x07, 0x31, 0x00, 0x13, 0x68, 0x41, 0x00,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05, 0x6A, 0x01, 0x7B, 0x06,
+    // DXYN: collision when drawn twice, none after erasing, coordinates wrap
+    0x6C, 0x00, 0x60, 0x38, 0x61, 0x18, 0x62, 0x08, 0xF2, 0x29, 0xD0, 0x15, 0xD0, 0x15, 0x4F, 0x01,
+    0x7C, 0x01, 0xD0, 0x15, 0x4F, 0x00, 0x7C, 0x01, 0x60, 0x78, 0x61, 0x38, 0xD0, 0x15, 0x4F, 0x01,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // Halt
+    0x13, 0xA4,
+    // Called three levels deep, each call adds 1 to VD
+    0x7D, 0x01, 0x23, 0xAC, 0x00, 0xEE, 0x7D, 0x01, 0x23, 0xB2, 0x00, 0xEE, 0x7D, 0x01, 0x00, 0xEE,
+    // Calls itself V0 times, adding 1 to VD
+    0x40, 0x00, 0x00, 0xEE, 0x70, 0xFF, 0x7D, 0x01, 0x23, 0xB6, 0x00, 0xEE
+};
+
+// VF of 8XY4, 8XY5, 8XY7, 8XY6, 8XYE and 7XNN, including VF as the first
+// operand, where the flag wins. Digits count checks passed: 9 7 7 5 5 2.
+static const byte FLAGS[] = {
+    // Digits are drawn from (1, 1), VA and VB hold the position
+    0x6A, 0x01, 0x6B, 0x01,
+    // 8XY4: 0x10 + 0x20, 0xF0 + 0x20, 0xFF + 0x01, carry into VF as X, VF as Y
+    0x6C, 0x00, 0x60, 0x10, 0x61, 0x20, 0x80, 0x14, 0x40, 0x30, 0x7C, 0x01, 0x4F, 0x00, 0x7C, 0x01,
+    0x60, 0xF0, 0x80, 0x14, 0x40, 0x10, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01, 0x60, 0xFF, 0x61, 0x01,
+    0x80, 0x14, 0x40, 0x00, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01, 0x6F, 0xF0, 0x61, 0x20, 0x8F, 0x14,
+    0x4F, 0x01, 0x7C, 0x01, 0x60, 0x05, 0x6F, 0xFF, 0x80, 0xF4, 0x40, 0x04, 0x7C, 0x01, 0x4F, 0x01,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XY5: 0x30 - 0x10, 0x10 - 0x30, 0x10 - 0x10, no borrow into VF as X
+    0x6C, 0x00, 0x60, 0x30, 0x61, 0x10, 0x80, 0x15, 0x40, 0x20, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01,
+    0x60, 0x10, 0x61, 0x30, 0x80, 0x15, 0x40, 0xE0, 0x7C, 0x01, 0x4F, 0x00, 0x7C, 0x01, 0x60, 0x10,
+    0x61, 0x10, 0x80, 0x15, 0x40, 0x00, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01, 0x6F, 0x30, 0x61, 0x10,
+    0x8F, 0x15, 0x4F, 0x01, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XY7: 0x30 - 0x10, 0x10 - 0x30, 0x10 - 0x10, no borrow into VF as X
+    0x6C, 0x00, 0x60, 0x10, 0x61, 0x30, 0x80, 0x17, 0x40, 0x20, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01,
+    0x60, 0x30, 0x61, 0x10, 0x80, 0x17, 0x40, 0xE0, 0x7C, 0x01, 0x4F, 0x00, 0x7C, 0x01, 0x60, 0x10,
+    0x61, 0x10, 0x80, 0x17, 0x40, 0x00, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01, 0x6F, 0x10, 0x61, 0x30,
+    0x8F, 0x17, 0x4F, 0x01, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XY6: 0x05 and 0x04 shifted right, bit 0 into VF as X
+    0x6C, 0x00, 0x60, 0x05, 0x80, 0x06, 0x40, 0x02, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01, 0x60, 0x04,
+    0x80, 0x06, 0x40, 0x02, 0x7C, 0x01, 0x4F, 0x00, 0x7C, 0x01, 0x6F, 0x03, 0x8F, 0xF6, 0x4F, 0x01,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XYE: 0x81 and 0x41 shifted left, bit 7 into VF as X
+    0x6C, 0x00, 0x60, 0x81, 0x80, 0x0E, 0x40, 0x02, 0x7C, 0x01, 0x4F, 0x01, 0x7C, 0x01, 0x60, 0x41,
+    0x80, 0x0E, 0x40, 0x82, 0x7C, 0x01, 0x4F, 0x00, 0x7C, 0x01, 0x6F, 0x80, 0x8F, 0xFE, 0x4F, 0x01,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 7XNN: no carry into VF
+    0x6C, 0x00, 0x6F, 0x55, 0x60, 0xFF, 0x70, 0x01, 0x40, 0x00, 0x7C, 0x01, 0x4F, 0x55, 0x7C, 0x01,
+    0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // Halt
+    0x13, 0x2A
+};
+
+// One digit per quirk, set to the number of its checks that behave the
+// quirky way: BXNN, VF reset by logic, I advanced by FX55 and FX65,
+// shifts of VY, sprites clipped at the edges. Digits by profile: modern
+// 0 0 0 0 0, vip 0 3 2 2 2, chip48 1 0 1 0 2, schip 1 0 0 0 2.
+static const byte QUIRKS[] = {
+    // Digits are drawn from (1, 1), VA and VB hold the position
+    0x6A, 0x01, 0x6B, 0x01,
+    // BNNN jumps to NNN + VX (VD = 0) rather than NNN + V0 (VD = 2)
+    0x6C, 0x00, 0x6D, 0x00, 0x60, 0x00, 0x62, 0x04, 0xB2, 0x0E, 0x7D, 0x01, 0x7D, 0x01, 0x4D, 0x00,
+    0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XY1 8XY2 8XY3 clear VF
+    0x6C, 0x00, 0x60, 0x01, 0x61, 0x02, 0x6F, 0x05, 0x80, 0x11, 0x4F, 0x00, 0x7C, 0x01, 0x6F, 0x05,
+    0x80, 0x12, 0x4F, 0x00, 0x7C, 0x01, 0x6F, 0x05, 0x80, 0x13, 0x4F, 0x00, 0x7C, 0x01, 0xFC, 0x29,
+    0xDA, 0xB5, 0x7A, 0x05,
+    // FX55 and FX65 advance I by X + 1 (twice), or by X
+    0x6C, 0x00, 0xAE, 0x00, 0x60, 0xAA, 0x61, 0xBB, 0xF1, 0x55, 0xF0, 0x65, 0x40, 0x00, 0x7C, 0x01,
+    0xAE, 0x00, 0x60, 0xAA, 0xF1, 0x55, 0xF0, 0x65, 0x40, 0xBB, 0x7C, 0x01, 0xAE, 0x00, 0xF0, 0x65,
+    0xF0, 0x65, 0x40, 0xBB, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // 8XY6 and 8XYE shift VY rather than VX
+    0x6C, 0x00, 0x60, 0x01, 0x61, 0x08, 0x80, 0x16, 0x40, 0x04, 0x7C, 0x01, 0x60, 0x01, 0x80, 0x1E,
+    0x40, 0x10, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // Sprites are clipped at the right and bottom edges rather than wrapping around
+    0x6C, 0x00, 0x62, 0x08, 0xF2, 0x29, 0x60, 0x3E, 0x61, 0x1C, 0xD0, 0x11, 0x60, 0x00, 0xD0, 0x11,
+    0x4F, 0x00, 0x7C, 0x01, 0x60, 0x3E, 0xD0, 0x11, 0x60, 0x00, 0xD0, 0x11, 0x60, 0x14, 0x61, 0x1F,
+    0xD0, 0x12, 0x61, 0x00, 0xA2, 0xC6, 0xD0, 0x11, 0x4F, 0x00, 0x7C, 0x01, 0xF2, 0x29, 0x61, 0x1F,
+    0xD0, 0x12, 0x61, 0x00, 0xA2, 0xC6, 0xD0, 0x11, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // Halt
+    0x12, 0xC4,
+    // Second row of font digit 8
+    0x90, 0x00
+};
+
+// FX0A, EX9E and EXA1 driven by KEYPAD_SCRIPT. Draws the keys FX0A
+// returned, key A once held, and the checks passed: 7 A 2 5.
+static const byte KEYPAD[] = {
+    // Digits are drawn from (1, 1), VA and VB hold the position
+    0x6A, 0x01, 0x6B, 0x01,
+    // FX0A: key 3 held from the start is ignored, key 7 pressed and released is stored
+    0xF0, 0x0A, 0xF0, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // EX9E: waits until key A is held
+    0x61, 0x0A, 0xE1, 0x9E, 0x12, 0x0E, 0xF1, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // EXA1: waits until key A is released
+    0xE1, 0xA1, 0x12, 0x18,
+    // EX9E EXA1: key 3 is not held
+    0x6C, 0x00, 0x62, 0x03, 0x6D, 0x00, 0xE2, 0x9E, 0x6D, 0x01, 0x4D, 0x01, 0x7C, 0x01, 0x6D, 0x00,
+    0xE2, 0xA1, 0x6D, 0x01, 0x4D, 0x00, 0x7C, 0x01, 0xFC, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // FX0A: key 5 pressed first and released while 6 is held is stored
+    0xF0, 0x0A, 0xF0, 0x29, 0xDA, 0xB5, 0x7A, 0x05,
+    // Halt
+    0x12, 0x42
+};
+
+// Key 3 is held before FX0A runs, 7 is pressed and released during it,
+// A is held for EX9E and EXA1, 5 is released while 6 is still held
+static const ScriptedKey KEYPAD_SCRIPT[] = {
+    {3, 0, 12},
+    {7, 5, 8},
+    {0xA, 20, 30},
+    {5, 40, 44},
+    {6, 42, 46}
+};
+
+static const ConformanceTest tests[] = {
+    {"opcodes", OPCODES, sizeof(OPCODES), NULL, 0, {0x03c0be97, 0x03c0be97, 0x03c0be97, 0x03c0be97}},
+    {"flags", FLAGS, sizeof(FLAGS), NULL, 0, {0x73ed4381, 0x73ed4381, 0x73ed4381, 0x73ed4381}},
+    {"quirks", QUIRKS, sizeof(QUIRKS), NULL, 0, {0x5b522471, 0x9df8505d, 0x58a7cf7a, 0xd4bc569e}},
+    {"keypad", KEYPAD, sizeof(KEYPAD), KEYPAD_SCRIPT, sizeof(KEYPAD_SCRIPT) / sizeof(KEYPAD_SCRIPT[0]),
+        {0xe7c48473, 0xe7c48473, 0xe7c48473, 0xe7c48473}}
+};
+
+static const int TEST_COUNT = sizeof(tests) / sizeof(tests[0]);
+
+/**
+ * Prints the screen, one character per pixel.
+ *
+ * @param screen Screen to be printed
+ */
+static void printScreen(Screen &screen) {
+    for (int y = 0; y < screen.getHeight(); y++) {
+        for (int x = 0; x < screen.getWidth(); x++) {
+            putchar(screen.isPixelOn(x, y) ? '#' : '.');
+        }
+        putchar('\n');
+    }
+}
+
+/**
+ * Runs a test ROM from reset with its scripted keys.
+ *
+ * @param test Test to be run
+ * @param profile Quirk profile it is run with
+ * @param useJit <code>true</code> to run it through the translator
+ * @param verbose <code>true</code> to print the final screen
+ * @return Hash of the final screen
+ */
+static uint32_t run(const ConformanceTest &test, int profile, bool useJit, bool verbose) {
+    Machine *machine = new Machine(CONFORMANCE_INSTRUCTIONS_PER_FRAME);
+    machine->loadRom(test.data, test.length, profile);
+#ifdef CHIPINO8_JIT
+    Jit jit(machine->cpu, machine->memory);
+    if (useJit && jit.isAvailable()) {
+        machine->scheduler.setEngine(jit);
+    }
+#else
+    (void)useJit;
+#endif
+    for (int frame = 0; frame < CONFORMANCE_FRAMES; frame++) {
+        for (int i = 0; i < test.keyCount; i++) {
+            if (test.keys[i].pressFrame == frame) {
+                machine->input.press(test.keys[i].key);
+            } else if (test.keys[i].releaseFrame == frame) {
+                machine->input.release(test.keys[i].key);
+            }
+        }
+        machine->runFrame();
+    }
+    if (verbose) {
+        printScreen(machine->screen);
+    }
+    uint32_t hash = machine->hashScreen();
+    delete machine;
+    return hash;
+}
+
+/**
+ * Saves a machine whose I ran past 0xFFFF and checks that the snapshot
+ * restores to the same state, and that copies with a negative I or PC
+ * are refused without changing the machine.
+ *
+ * @return <code>true</code> if all checks passed, <code>false</code> otherwise
+ */
+static bool checkSnapshots() {
+    // FX1E in a loop
+    static const byte rom[] = {0x60, 0xFF, 0xF0, 0x1E, 0x12, 0x02};
+    static byte saved[SNAPSHOT_MAX_SIZE];
+    static byte copy[SNAPSHOT_MAX_SIZE];
+    static byte check[SNAPSHOT_MAX_SIZE];
+
+    Machine *machine = new Machine(CONFORMANCE_INSTRUCTIONS_PER_FRAME);
+    machine->loadRom(rom, sizeof(rom));
+    for (int frame = 0; frame < CONFORMANCE_FRAMES; frame++) {
+        machine->runFrame();
+    }
+    int length = Snapshot::save(machine->cpu, machine->memory, machine->screen, saved, sizeof(saved));
+    delete machine;
+    // I follows the registers, PC follows I
+    int offsetI = SNAPSHOT_HEADER_SIZE + NUM_REGISTERS;
+    bool passed = length > 0 && saved[offsetI + 2] != 0;
+
+    Machine *restored = new Machine(CONFORMANCE_INSTRUCTIONS_PER_FRAME);
+    restored->loadRom(rom, sizeof(rom));
+    passed = passed && Snapshot::restore(restored->cpu, restored->memory, restored->screen, saved, length);
+    passed = passed && Snapshot::save(restored->cpu, restored->memory, restored->screen, check, sizeof(check)) == length
+        && memcmp(saved, check, length) == 0;
+
+    for (int offset = offsetI; passed && offset <= offsetI + 4; offset += 4) {
+        memcpy(copy, saved, length);
+        memset(copy + offset, 0xFF, 4);
+        int body = length - SNAPSHOT_CHECKSUM_SIZE;
+        uint16_t sum = Snapshot::checksum(copy, body);
+        copy[body] = sum & 0xFF;
+        copy[body + 1] = sum >> 8;
+        passed = !Snapshot::restore(restored->cpu, restored->memory, restored->screen, copy, length)
+            && Snapshot::save(restored->cpu, restored->memory, restored->screen, check, sizeof(check)) == length
+            && memcmp(saved, check, length) == 0;
+    }
+    delete restored;
+    printf("%-18s %s\n", "snapshot", passed ? "ok" : "FAIL");
+    return passed;
+}
+
+/**
+ * Conformance suite.
+ *
+ * Runs built in test ROMs for opcodes, flags, quirks and keypad from
+ * reset for a fixed number of instructions with each quirk profile and
+ * compares the hash of the screen with the one stored for the profile,
+ * then checks that snapshots refuse a negative I or PC. Exits non-zero
+ * when any check fails.
+ *
+ * Usage: chipino8_conformance [-j] [-v] [-q quirks] [test...]
+ *
+ * -j runs the ROMs with the basic-block translator.
+ * -v prints the final screens.
+ * -q runs the ROMs with the given quirk profile only.
+ */
+int main(int argc, char **argv) {
+    bool useJit = false;
+    bool verbose = false;
+    int onlyProfile = -1;
+    std::vector<const char *> selected;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0) {
+            useJit = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            onlyProfile = CPU::findQuirkProfile(argv[++i]);
+            if (onlyProfile < 0) {
+                fprintf(stderr, "unknown quirk profile %s\n", argv[i]);
+                return 2;
+            }
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: chipino8_conformance [-j] [-v] [-q quirks] [test...]\n");
+            return 2;
+        } else {
+            selected.push_back(argv[i]);
+        }
+    }
+#ifndef CHIPINO8_JIT
+    if (useJit) {
+        fprintf(stderr, "translator not built for this host\n");
+        return 2;
+    }
+#endif
+
+    int failures = 0;
+    for (int t = 0; t < TEST_COUNT; t++) {
+        bool wanted = selected.empty();
+        for (size_t i = 0; i < selected.size(); i++) {
+            wanted = wanted || strcmp(selected[i], tests[t].name) == 0;
+        }
+        if (!wanted) {
+            continue;
+        }
+        for (int profile = 0; profile < PROFILE_COUNT; profile++) {
+            if (onlyProfile >= 0 && profile != onlyProfile) {
+                continue;
+            }
+            uint32_t hash = run(tests[t], profile, useJit, verbose);
+            bool passed = hash == tests[t].goldens[profile];
+            printf("%-10s %-7s %08x %s", tests[t].name, CPU::getQuirkProfileName(profile), hash, passed ? "ok" : "FAIL");
+            if (!passed) {
+                printf(" (expected %08x)", tests[t].goldens[profile]);
+                failures++;
+            }
+            printf("\n");
+        }
+    }
+    if (selected.empty() && !checkSnapshots()) {
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
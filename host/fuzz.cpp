@@ -0,0 +1,798 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "machine.h"
+#include "lockstep.h"
+#include "../input_log.h"
+#include "../snapshot.h"
+#ifdef CHIPINO8_JIT
+#include "jit.h"
+#endif
+
+// Most frames a case runs
+#define FUZZ_MAX_FRAMES 64
+// Most instructions per frame of a case
+#define FUZZ_MAX_INSTRUCTIONS_PER_FRAME 512
+// Size of the case header: frames, instructions per frame, seed,
+// quirk profile, number of key entries
+#define FUZZ_HEADER_SIZE 9
+// Size of a key entry: frame, keys held from it on
+#define FUZZ_KEY_ENTRY_SIZE 3
+// Longest ROM of a case
+#define FUZZ_MAX_ROM_SIZE (MEMORY_SIZE - PC_START)
+// Longest ROM generated
+#define FUZZ_GENERATED_ROM_SIZE 512
+// Lanes of the lockstep engines, all running the same case so that
+// they execute as one group
+#define FUZZ_LANES 4
+// Cases generated when not given
+#define DEFAULT_CASES 1000
+// Buffer of the input log written with a reproducer
+#define FUZZ_INPUT_LOG_SIZE (INPUT_LOG_HEADER_SIZE + FUZZ_MAX_FRAMES * INPUT_LOG_ENTRY_SIZE + INPUT_LOG_CHECKSUM_SIZE)
+
+/**
+ * Input of one differential run: a ROM, the keys held in each frame,
+ * the CXNN seed, the speed and the quirks.
+ *
+ * Fuzzers hand it over as bytes: frames - 1, instructions per frame - 1
+ * (16 bit), seed (32 bit), quirk profile, number of key entries, then
+ * key entries of frame and keys held from it on (16 bit), then the ROM.
+ * Values out of range wrap, so any input is a valid case.
+ */
+struct FuzzCase {
+    int frames;
+    int instructionsPerFrame;
+    uint32_t seed;
+    // One of QuirkProfile
+    int profile;
+    // Keys held in each frame
+    uint16_t keys[FUZZ_MAX_FRAMES];
+    std::vector<byte> rom;
+};
+
+/**
+ * Engines compared with the reference core.
+ */
+enum EngineKind {
+    // CPU::runReference(), execute(int) on opcodes fetched from memory
+    ENGINE_REFERENCE,
+    // CPU::runSwitch(), decode cache
+    ENGINE_SWITCH,
+    // CPU::runThreaded(), decode cache, fusions and idle skip
+    ENGINE_THREADED,
+    // Jit, basic blocks translated to x86-64
+    ENGINE_JIT,
+    // Lockstep with AVX2 kernels, compared once per frame, modern quirks only
+    ENGINE_LOCKSTEP,
+    // Lockstep without AVX2, compared once per frame, modern quirks only
+    ENGINE_LOCKSTEP_SCALAR,
+    ENGINE_COUNT
+};
+
+static const char *const ENGINE_NAMES[ENGINE_COUNT] = {
+    "reference", "switch", "threaded", "jit", "lockstep", "lockstep-scalar"
+};
+
+/**
+ * First difference found between the reference core and an engine.
+ */
+struct Divergence {
+    int engine;
+    int frame;
+    // Instructions into the frame, -1 if not located
+    int instruction;
+    // PC and opcode the reference executed last, when located
+    int pc;
+    int opcode;
+    char what[128];
+};
+
+/**
+ * Runs one of the CPU's own interpreter cores.
+ */
+class CoreEngine : public Engine {
+    private:
+        CPU &cpu;
+        int (CPU::*core)(int count);
+
+    public:
+        CoreEngine(CPU &cpu, int (CPU::*core)(int count)) : cpu(cpu), core(core) {}
+
+        int run(int count) {
+            return (cpu.*core)(count);
+        }
+};
+
+/**
+ * Machine running a case on one of the CPU engines.
+ */
+class Instance {
+    public:
+        Machine machine;
+
+    private:
+        CoreEngine core;
+#ifdef CHIPINO8_JIT
+        Jit *jit;
+#endif
+
+        // Instance is wired to its own members, copies are not allowed
+        Instance(const Instance &) = delete;
+        Instance &operator=(const Instance &) = delete;
+
+    public:
+        /**
+         * @param fuzzCase Case to be run
+         * @param engine One of EngineKind below ENGINE_LOCKSTEP
+         */
+        Instance(const FuzzCase &fuzzCase, int engine) :
+            machine(fuzzCase.instructionsPerFrame, fuzzCase.seed),
+            core(machine.cpu, engine == ENGINE_REFERENCE ? &CPU::runReference
+                : engine == ENGINE_SWITCH ? &CPU::runSwitch : &CPU::runThreaded) {
+            machine.loadRom(fuzzCase.rom.data(), (int)fuzzCase.rom.size(), fuzzCase.profile);
+            machine.scheduler.setEngine(core);
+#ifdef CHIPINO8_JIT
+            jit = NULL;
+            if (engine == ENGINE_JIT) {
+                jit = new Jit(machine.cpu, machine.memory);
+                machine.scheduler.setEngine(*jit);
+            }
+#endif
+        }
+
+        ~Instance() {
+#ifdef CHIPINO8_JIT
+            delete jit;
+#endif
+        }
+
+        /**
+         * @return Engine the scheduler runs
+         */
+        Engine &engine() {
+#ifdef CHIPINO8_JIT
+            if (jit) {
+                return *jit;
+            }
+#endif
+            return core;
+        }
+
+        /**
+         * Presses and releases keys to match a mask.
+         *
+         * @param mask Bit N set if key N is held
+         */
+        void setKeys(uint16_t mask) {
+            for (int key = 0; key < NUM_KEYS; key++) {
+                if (mask & (1 << key)) {
+                    machine.input.press((char)key);
+                } else {
+                    machine.input.release((char)key);
+                }
+            }
+        }
+};
+
+/**
+ * @return <code>true</code> if the engine can run on this host, <code>false</code> otherwise
+ */
+static bool isAvailable(int engine) {
+    if (engine == ENGINE_JIT) {
+#ifdef CHIPINO8_JIT
+        Machine machine;
+        Jit jit(machine.cpu, machine.memory);
+        return jit.isAvailable();
+#else
+        return false;
+#endif
+    }
+    return true;
+}
+
+/**
+ * Advances an xorshift32 generator.
+ *
+ * @param state Generator state, never 0
+ * @return New state
+ */
+static uint32_t next(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/**
+ * Reads a case from fuzzer input, see FuzzCase.
+ */
+static void parseCase(const byte *data, size_t size, FuzzCase &fuzzCase) {
+    byte header[FUZZ_HEADER_SIZE] = {0};
+    memcpy(header, data, size < FUZZ_HEADER_SIZE ? size : FUZZ_HEADER_SIZE);
+    fuzzCase.frames = header[0] % FUZZ_MAX_FRAMES + 1;
+    fuzzCase.instructionsPerFrame = (header[1] | (header[2] << 8)) % FUZZ_MAX_INSTRUCTIONS_PER_FRAME + 1;
+    fuzzCase.seed = header[3] | (header[4] << 8) | (header[5] << 16) | ((uint32_t)header[6] << 24);
+    fuzzCase.profile = header[7] % PROFILE_COUNT;
+
+    memset(fuzzCase.keys, 0, sizeof(fuzzCase.keys));
+    size_t at = FUZZ_HEADER_SIZE;
+    for (int i = 0; i < header[8] && at + FUZZ_KEY_ENTRY_SIZE <= size; i++) {
+        for (int frame = data[at] % FUZZ_MAX_FRAMES; frame < FUZZ_MAX_FRAMES; frame++) {
+            fuzzCase.keys[frame] = data[at + 1] | (data[at + 2] << 8);
+        }
+        at += FUZZ_KEY_ENTRY_SIZE;
+    }
+
+    size_t length = at < size ? size - at : 0;
+    if (length > FUZZ_MAX_ROM_SIZE) {
+        length = FUZZ_MAX_ROM_SIZE;
+    }
+    fuzzCase.rom.assign(data + at, data + at + length);
+}
+
+/**
+ * Writes a case as fuzzer input, so that parseCase() reads it back.
+ */
+static std::vector<byte> serializeCase(const FuzzCase &fuzzCase) {
+    std::vector<byte> data(FUZZ_HEADER_SIZE);
+    data[0] = fuzzCase.frames - 1;
+    data[1] = (fuzzCase.instructionsPerFrame - 1) & 0xFF;
+    data[2] = (fuzzCase.instructionsPerFrame - 1) >> 8;
+    for (int i = 0; i < 4; i++) {
+        data[3 + i] = (fuzzCase.seed >> (8 * i)) & 0xFF;
+    }
+    data[7] = fuzzCase.profile;
+    int entries = 0;
+    uint16_t held = 0;
+    for (int frame = 0; frame < fuzzCase.frames; frame++) {
+        if (fuzzCase.keys[frame] != held) {
+            held = fuzzCase.keys[frame];
+            data.push_back(frame);
+            data.push_back(held & 0xFF);
+            data.push_back(held >> 8);
+            entries++;
+        }
+    }
+    data[8] = entries;
+    data.insert(data.end(), fuzzCase.rom.begin(), fuzzCase.rom.end());
+    return data;
+}
+
+/**
+ * Generates a random case. Instructions are biased towards jumps and
+ * calls that stay in the ROM, memory writes, key instructions and
+ * flag setting arithmetic, so that runs last and reach the engines'
+ * special paths.
+ */
+static void generateCase(uint32_t &state, FuzzCase &fuzzCase) {
+    static const int SPEEDS[] = {1, 7, 37, 100, 500};
+    static const int ARITHMETIC[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+    static const int MISC[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65};
+    fuzzCase.frames = 16 + next(state) % (FUZZ_MAX_FRAMES - 15);
+    fuzzCase.instructionsPerFrame = SPEEDS[next(state) % (sizeof(SPEEDS) / sizeof(SPEEDS[0]))];
+    fuzzCase.seed = next(state);
+    fuzzCase.profile = next(state) % PROFILE_COUNT;
+
+    uint16_t held = 0;
+    for (int frame = 0; frame < FUZZ_MAX_FRAMES; frame++) {
+        switch (next(state) % 8) {
+            case 0: held = 0; break;
+            case 1: held = 1 << (next(state) % NUM_KEYS); break;
+            case 2: held = (uint16_t)next(state); break;
+        }
+        fuzzCase.keys[frame] = held;
+    }
+
+    int length = 2 * (16 + next(state) % (FUZZ_GENERATED_ROM_SIZE / 2 - 15));
+    fuzzCase.rom.resize(length);
+    for (int i = 0; i < length; i += 2) {
+        int target = PC_START + (next(state) % (length / 2)) * 2;
+        int x = next(state) & 0xF;
+        int y = next(state) & 0xF;
+        int opcode;
+        switch (next(state) % 16) {
+            case 0: opcode = 0x1000 | target; break;
+            case 1: opcode = 0x2000 | target; break;
+            case 2: opcode = 0x00EE; break;
+            case 3: opcode = 0xB000 | (target - (next(state) % 8)); break;
+            case 4:
+            case 5: opcode = 0x8000 | (x << 8) | (y << 4) | ARITHMETIC[next(state) % 9]; break;
+            case 6: opcode = 0xA000 | (next(state) % 2 ? target : next(state) % 0xA0); break;
+            case 7: opcode = 0xF000 | (x << 8) | MISC[next(state) % 9]; break;
+            case 8: opcode = 0xE000 | (x << 8) | (next(state) % 2 ? 0x9E : 0xA1); break;
+            case 9: opcode = 0x3000 | (next(state) % 3) << 12 | (x << 8) | (next(state) & 0xFF); break;
+            case 10: opcode = (next(state) % 2 ? 0x5000 : 0x9000) | (x << 8) | (y << 4); break;
+            case 11: opcode = 0xD000 | (x << 8) | (y << 4) | (next(state) & 0xF); break;
+            default: opcode = next(state) & 0xFFFF; break;
+        }
+        fuzzCase.rom[i] = opcode >> 8;
+        fuzzCase.rom[i + 1] = opcode & 0xFF;
+    }
+}
+
+/**
+ * Names the field of a CPU section at given offset, see CPU::saveState().
+ */
+static void cpuField(int offset, char *name, int size) {
+    if (offset < NUM_REGISTERS) {
+        snprintf(name, size, "V%X", offset);
+    } else if (offset < NUM_REGISTERS + 4) {
+        snprintf(name, size, "I");
+    } else if (offset < NUM_REGISTERS + 8) {
+        snprintf(name, size, "PC");
+    } else if (offset < NUM_REGISTERS + 10) {
+        snprintf(name, size, "stack pointer");
+    } else if (offset < NUM_REGISTERS + 10 + 2 * STACK_SIZE) {
+        snprintf(name, size, "stack[%d]", (offset - NUM_REGISTERS - 10) / 2);
+    } else {
+        static const char *const rest[] = {"delay timer", "sound timer", "key wait", "waited key"};
+        int index = offset - NUM_REGISTERS - 10 - 2 * STACK_SIZE;
+        snprintf(name, size, "%s", index < 4 ? rest[index] : "random state");
+    }
+}
+
+/**
+ * Compares CPU sections, RAM and framebuffers of two machines.
+ *
+ * @return <code>true</code> if they differ, what differs is written to what
+ */
+static bool differ(Machine &reference, Machine &other, const char *engine, char *what, int size) {
+    byte cpuStates[2][SNAPSHOT_CPU_SIZE];
+    StateWriter referenceOut(cpuStates[0], SNAPSHOT_CPU_SIZE);
+    StateWriter otherOut(cpuStates[1], SNAPSHOT_CPU_SIZE);
+    reference.cpu.saveState(referenceOut);
+    other.cpu.saveState(otherOut);
+    for (int i = 0; i < SNAPSHOT_CPU_SIZE; i++) {
+        if (cpuStates[0][i] != cpuStates[1][i]) {
+            char name[32];
+            cpuField(i, name, sizeof(name));
+            snprintf(what, size, "%s (byte %d): reference %02x, %s %02x", name, i, cpuStates[0][i], engine, cpuStates[1][i]);
+            return true;
+        }
+    }
+    for (int i = 0; i < MEMORY_SIZE; i++) {
+        if (reference.mem[i] != other.mem[i]) {
+            snprintf(what, size, "RAM %03x: reference %02x, %s %02x", i, reference.mem[i], engine, other.mem[i]);
+            return true;
+        }
+    }
+    if (reference.screen.getWidth() != other.screen.getWidth() || reference.screen.getHeight() != other.screen.getHeight()) {
+        snprintf(what, size, "screen size: reference %dx%d, %s %dx%d", reference.screen.getWidth(),
+            reference.screen.getHeight(), engine, other.screen.getWidth(), other.screen.getHeight());
+        return true;
+    }
+    byte rows[2][MAX_WIDTH / 8];
+    for (int y = 0; y < reference.screen.getHeight(); y++) {
+        reference.screen.getRow(y, rows[0]);
+        other.screen.getRow(y, rows[1]);
+        if (memcmp(rows[0], rows[1], reference.screen.getWidth() / 8) != 0) {
+            snprintf(what, size, "screen row %d differs", y);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Compares what Lockstep exposes of its lanes with a machine. All lanes
+ * run the same case, so they must agree with each other too.
+ *
+ * @return <code>true</code> if they differ, what differs is written to what
+ */
+static bool differ(Machine &reference, Lockstep &lockstep, const char *engine, char *what, int size) {
+    for (int lane = 0; lane < lockstep.getLanes(); lane++) {
+        for (int r = 0; r < NUM_REGISTERS; r++) {
+            if (reference.cpu.getRegister(r) != lockstep.getRegister(lane, r)) {
+                snprintf(what, size, "V%X of lane %d: reference %02x, %s %02x", r, lane, reference.cpu.getRegister(r),
+                    engine, lockstep.getRegister(lane, r));
+                return true;
+            }
+        }
+        if (reference.cpu.getPC() != lockstep.getPC(lane)) {
+            snprintf(what, size, "PC of lane %d: reference %03x, %s %03x", lane, reference.cpu.getPC(), engine,
+                lockstep.getPC(lane));
+            return true;
+        }
+        if (reference.cpu.isWaitingForKey() != lockstep.isWaitingForKey(lane)) {
+            snprintf(what, size, "key wait of lane %d: reference %d, %s %d", lane, reference.cpu.isWaitingForKey(), engine,
+                lockstep.isWaitingForKey(lane));
+            return true;
+        }
+        const byte *memory = lockstep.getMemory(lane);
+        for (int i = 0; i < MEMORY_SIZE; i++) {
+            if (reference.mem[i] != memory[i]) {
+                snprintf(what, size, "RAM %03x of lane %d: reference %02x, %s %02x", i, lane, reference.mem[i], engine,
+                    memory[i]);
+                return true;
+            }
+        }
+        if (reference.hashScreen() != lockstep.hashScreen(lane)) {
+            snprintf(what, size, "screen of lane %d differs", lane);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Finds the first instruction of a diverging frame after which the
+ * engine differs from the reference. Both are rerun from reset to the
+ * frame, then for a number of instructions, bisecting that number.
+ * Engines that run blocks or fused sequences at once are located to the
+ * last instruction of the block.
+ */
+static void locate(const FuzzCase &fuzzCase, Divergence &divergence) {
+    int low = 0;
+    int high = fuzzCase.instructionsPerFrame;
+    char what[sizeof(divergence.what)];
+    bool found = false;
+    while (low < high) {
+        int count = (low + high) / 2 + 1;
+        Instance reference(fuzzCase, ENGINE_REFERENCE);
+        Instance other(fuzzCase, divergence.engine);
+        for (int frame = 0; frame < divergence.frame; frame++) {
+            reference.setKeys(fuzzCase.keys[frame]);
+            other.setKeys(fuzzCase.keys[frame]);
+            reference.machine.runFrame();
+            other.machine.runFrame();
+        }
+        reference.setKeys(fuzzCase.keys[divergence.frame]);
+        other.setKeys(fuzzCase.keys[divergence.frame]);
+        reference.machine.keyboard.scan();
+        other.machine.keyboard.scan();
+        // Engines stop early on FX0A, the last instruction is not run then
+        reference.engine().run(count - 1);
+        int pc = reference.machine.cpu.getPC();
+        if (!reference.machine.cpu.isWaitingForKey()) {
+            reference.engine().run(1);
+        }
+        other.engine().run(count);
+        if (differ(reference.machine, other.machine, ENGINE_NAMES[divergence.engine], what, sizeof(what))) {
+            high = count - 1;
+            found = true;
+            divergence.instruction = count;
+            divergence.pc = pc;
+            divergence.opcode = (reference.machine.memory.getByte(pc) << 8) | reference.machine.memory.getByte(pc + 1);
+            memcpy(divergence.what, what, sizeof(what));
+        } else {
+            low = count;
+        }
+    }
+    if (!found) {
+        // Differs only once timers ticked at the end of the frame
+        divergence.instruction = -1;
+    }
+}
+
+/**
+ * Runs a case on the reference core and the selected engines, comparing
+ * them after every frame.
+ *
+ * @param fuzzCase Case to be run
+ * @param engines Bit N set to run engine N
+ * @param divergence First difference found
+ * @return <code>true</code> if an engine diverged, <code>false</code> otherwise
+ */
+static bool runCase(const FuzzCase &fuzzCase, int engines, Divergence &divergence) {
+    Instance reference(fuzzCase, ENGINE_REFERENCE);
+    std::vector<Instance *> instances(ENGINE_COUNT, (Instance *)NULL);
+    std::vector<Lockstep *> lockstep(ENGINE_COUNT, (Lockstep *)NULL);
+    for (int engine = ENGINE_SWITCH; engine < ENGINE_COUNT; engine++) {
+        if (!(engines & (1 << engine))) {
+            continue;
+        }
+        if (engine == ENGINE_LOCKSTEP || engine == ENGINE_LOCKSTEP_SCALAR) {
+            if (fuzzCase.profile != PROFILE_MODERN) {
+                continue;
+            }
+            lockstep[engine] = new Lockstep(FUZZ_LANES, fuzzCase.instructionsPerFrame, engine == ENGINE_LOCKSTEP);
+            lockstep[engine]->loadRom(fuzzCase.rom.data(), (int)fuzzCase.rom.size());
+            for (int lane = 0; lane < FUZZ_LANES; lane++) {
+                lockstep[engine]->seed(lane, fuzzCase.seed);
+            }
+        } else {
+            instances[engine] = new Instance(fuzzCase, engine);
+        }
+    }
+
+    bool diverged = false;
+    for (int frame = 0; frame < fuzzCase.frames && !diverged; frame++) {
+        reference.setKeys(fuzzCase.keys[frame]);
+        reference.machine.runFrame();
+        for (int engine = ENGINE_SWITCH; engine < ENGINE_COUNT && !diverged; engine++) {
+            if (instances[engine]) {
+                instances[engine]->setKeys(fuzzCase.keys[frame]);
+                instances[engine]->machine.runFrame();
+                diverged = differ(reference.machine, instances[engine]->machine, ENGINE_NAMES[engine], divergence.what,
+                    sizeof(divergence.what));
+            } else if (lockstep[engine]) {
+                for (int lane = 0; lane < FUZZ_LANES; lane++) {
+                    lockstep[engine]->setKeys(lane, fuzzCase.keys[frame]);
+                }
+                lockstep[engine]->runFrame();
+                diverged = differ(reference.machine, *lockstep[engine], ENGINE_NAMES[engine], divergence.what,
+                    sizeof(divergence.what));
+            }
+            if (diverged) {
+                divergence.engine = engine;
+                divergence.frame = frame;
+                divergence.instruction = -1;
+            }
+        }
+    }
+
+    for (int engine = 0; engine < ENGINE_COUNT; engine++) {
+        delete instances[engine];
+        delete lockstep[engine];
+    }
+    if (diverged && divergence.engine != ENGINE_LOCKSTEP && divergence.engine != ENGINE_LOCKSTEP_SCALAR) {
+        locate(fuzzCase, divergence);
+    }
+    return diverged;
+}
+
+/**
+ * Prints a divergence.
+ */
+static void report(const Divergence &divergence) {
+    fprintf(stderr, "divergence: %s at frame %d", ENGINE_NAMES[divergence.engine], divergence.frame);
+    if (divergence.instruction >= 0) {
+        fprintf(stderr, ", after instruction %d of the frame (PC %03x, opcode %04x)", divergence.instruction, divergence.pc,
+            divergence.opcode);
+    }
+    fprintf(stderr, ": %s\n", divergence.what);
+}
+
+/**
+ * Shrinks a diverging case while the engine still diverges: drops
+ * frames after the divergence, halves the ROM, clears instructions and
+ * keys one at a time, lowers the speed.
+ *
+ * @param fuzzCase Case to be shrunk
+ * @param divergence Divergence of the case, updated
+ */
+static void minimize(FuzzCase &fuzzCase, Divergence &divergence) {
+    int engines = 1 << divergence.engine;
+    Divergence found;
+    bool shrunk = true;
+    while (shrunk) {
+        shrunk = false;
+        fuzzCase.frames = divergence.frame + 1;
+
+        while (fuzzCase.rom.size() > 2) {
+            std::vector<byte> rom = fuzzCase.rom;
+            fuzzCase.rom.resize(rom.size() / 4 * 2);
+            if (!runCase(fuzzCase, engines, found)) {
+                fuzzCase.rom = rom;
+                break;
+            }
+            divergence = found;
+            shrunk = true;
+        }
+        for (int i = (int)fuzzCase.rom.size() - 2; i >= 0; i -= 2) {
+            if (fuzzCase.rom[i] == 0 && fuzzCase.rom[i + 1] == 0) {
+                continue;
+            }
+            byte high = fuzzCase.rom[i];
+            byte low = fuzzCase.rom[i + 1];
+            fuzzCase.rom[i] = 0;
+            fuzzCase.rom[i + 1] = 0;
+            if (runCase(fuzzCase, engines, found)) {
+                divergence = found;
+                shrunk = true;
+            } else {
+                fuzzCase.rom[i] = high;
+                fuzzCase.rom[i + 1] = low;
+            }
+        }
+        while (fuzzCase.rom.size() > 2 && fuzzCase.rom[fuzzCase.rom.size() - 1] == 0
+            && fuzzCase.rom[fuzzCase.rom.size() - 2] == 0) {
+            fuzzCase.rom.resize(fuzzCase.rom.size() - 2);
+        }
+
+        for (int frame = 0; frame < fuzzCase.frames; frame++) {
+            if (fuzzCase.keys[frame] == 0) {
+                continue;
+            }
+            uint16_t held = fuzzCase.keys[frame];
+            fuzzCase.keys[frame] = 0;
+            if (runCase(fuzzCase, engines, found)) {
+                divergence = found;
+                shrunk = true;
+            } else {
+                fuzzCase.keys[frame] = held;
+            }
+        }
+
+        if (fuzzCase.instructionsPerFrame > 1) {
+            int speed = fuzzCase.instructionsPerFrame;
+            fuzzCase.instructionsPerFrame = speed / 2;
+            if (runCase(fuzzCase, engines, found)) {
+                divergence = found;
+                shrunk = true;
+            } else {
+                fuzzCase.instructionsPerFrame = speed;
+            }
+        }
+    }
+    fuzzCase.frames = divergence.frame + 1;
+}
+
+/**
+ * Writes a reproducer: the ROM, an input log recorded from a reference
+ * run that chipino8_host -i replays, and the case as fuzzer input.
+ *
+ * @param fuzzCase Case
+ * @param prefix Path the file extensions are appended to
+ * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+ */
+static bool writeReproducer(const FuzzCase &fuzzCase, const char *prefix) {
+    std::string name = prefix;
+    Instance reference(fuzzCase, ENGINE_REFERENCE);
+    Machine &machine = reference.machine;
+    if (machine.storage.write((name + ".ch8").c_str(), fuzzCase.rom.data(), (int)fuzzCase.rom.size())
+        != (int)fuzzCase.rom.size()) {
+        return false;
+    }
+
+    byte buffer[FUZZ_INPUT_LOG_SIZE];
+    InputLog log(buffer, sizeof(buffer));
+    log.startRecording(fuzzCase.profile, fuzzCase.seed, fuzzCase.instructionsPerFrame, Snapshot::checksum(machine.mem, MEMORY_SIZE));
+    machine.scheduler.setInputLog(&log);
+    for (int frame = 0; frame < fuzzCase.frames; frame++) {
+        reference.setKeys(fuzzCase.keys[frame]);
+        machine.runFrame();
+    }
+    if (!log.save(machine.storage, (name + ".c8i").c_str())) {
+        return false;
+    }
+
+    std::vector<byte> data = serializeCase(fuzzCase);
+    return machine.storage.write((name + ".fuzz").c_str(), data.data(), (int)data.size()) == (int)data.size();
+}
+
+/**
+ * @return Bit set of the engines available on this host
+ */
+static int availableEngines() {
+    int engines = 0;
+    for (int engine = ENGINE_SWITCH; engine < ENGINE_COUNT; engine++) {
+        if (isAvailable(engine)) {
+            engines |= 1 << engine;
+        }
+    }
+    return engines;
+}
+
+#ifdef CHIPINO8_LIBFUZZER
+
+/**
+ * libFuzzer entry point, aborts on a divergence.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static const int engines = availableEngines();
+    FuzzCase fuzzCase;
+    parseCase(data, size, fuzzCase);
+    Divergence divergence;
+    if (runCase(fuzzCase, engines, divergence)) {
+        report(divergence);
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+/**
+ * Differential fuzzer.
+ *
+ * Runs cases on the reference core, CPU::execute(int) on opcodes
+ * fetched from memory, and on the optimised engines side by side, and
+ * compares registers, RAM and framebuffer after every frame. The first
+ * divergence is located to an instruction and reported.
+ *
+ * Without files, generates random cases; the first diverging one is
+ * minimised and written as a reproducer. With files, runs them as
+ * fuzzer input and aborts on a divergence, so that AFL records it
+ * (afl-fuzz -i in -o out -- chipino8_fuzz @@), or with -m minimises it.
+ *
+ * Usage: chipino8_fuzz [-n cases] [-s seed] [-e engine] [-o prefix] [-m] [file...]
+ *
+ * -e compares the reference with the given engine only.
+ * -o sets the path of the reproducer, PREFIX.ch8, PREFIX.c8i and
+ *    PREFIX.fuzz (default "divergence").
+ */
+int main(int argc, char **argv) {
+    long cases = DEFAULT_CASES;
+    uint32_t seed = 1;
+    int engines = availableEngines();
+    const char *prefix = "divergence";
+    bool minimizeFiles = false;
+    std::vector<const char *> fileNames;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-n") == 0 && hasValue) {
+            cases = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && hasValue) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-e") == 0 && hasValue) {
+            const char *name = argv[++i];
+            int engine = ENGINE_SWITCH;
+            while (engine < ENGINE_COUNT && strcmp(ENGINE_NAMES[engine], name) != 0) {
+                engine++;
+            }
+            if (engine == ENGINE_COUNT || !(engines & (1 << engine))) {
+                fprintf(stderr, "engine %s not available\n", name);
+                return 2;
+            }
+            engines = 1 << engine;
+        } else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+            prefix = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            minimizeFiles = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: chipino8_fuzz [-n cases] [-s seed] [-e engine] [-o prefix] [-m] [file...]\n");
+            return 2;
+        } else {
+            fileNames.push_back(argv[i]);
+        }
+    }
+
+    FuzzCase fuzzCase;
+    Divergence divergence;
+    bool diverged = false;
+    if (!fileNames.empty()) {
+        for (size_t i = 0; i < fileNames.size() && !diverged; i++) {
+            static byte data[FUZZ_HEADER_SIZE + 255 * FUZZ_KEY_ENTRY_SIZE + FUZZ_MAX_ROM_SIZE];
+            HostStorage storage;
+            int length = storage.read(fileNames[i], data, sizeof(data));
+            if (length < 0) {
+                fprintf(stderr, "error reading %s\n", fileNames[i]);
+                return 1;
+            }
+            parseCase(data, length, fuzzCase);
+            diverged = runCase(fuzzCase, engines, divergence);
+            if (diverged) {
+                fprintf(stderr, "%s: ", fileNames[i]);
+                report(divergence);
+                if (!minimizeFiles) {
+                    abort();
+                }
+            }
+        }
+    } else {
+        uint32_t state = seed ? seed : 1;
+        for (long i = 0; i < cases && !diverged; i++) {
+            generateCase(state, fuzzCase);
+            diverged = runCase(fuzzCase, engines, divergence);
+            if (diverged) {
+                fprintf(stderr, "case %ld, %s quirks: ", i, CPU::getQuirkProfileName(fuzzCase.profile));
+                report(divergence);
+            }
+        }
+        if (!diverged) {
+            printf("%ld cases, no divergence\n", cases);
+        }
+    }
+    if (!diverged) {
+        return 0;
+    }
+
+    minimize(fuzzCase, divergence);
+    fprintf(stderr, "minimized to %d bytes of ROM, %d frames at %d instructions per frame, %s quirks\n",
+        (int)fuzzCase.rom.size(), fuzzCase.frames, fuzzCase.instructionsPerFrame, CPU::getQuirkProfileName(fuzzCase.profile));
+    report(divergence);
+    if (!writeReproducer(fuzzCase, prefix)) {
+        fprintf(stderr, "error writing reproducer %s\n", prefix);
+        return 1;
+    }
+    fprintf(stderr, "reproducer: %s.ch8 %s.c8i %s.fuzz, replay with chipino8_host -i %s.c8i %s.ch8\n", prefix,
+        prefix, prefix, prefix, prefix);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "hal_host.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+HostDisplay::HostDisplay() : updates(0), bytesWritten(0) {
+    clear();
+}
+
+void HostDisplay::begin() {}
+
+void HostDisplay::writePage(int page, int column, const byte *data, int length) {
+    if (column + length > HOST_PANEL_WIDTH) {
+        length = HOST_PANEL_WIDTH - column;
+    }
+    memcpy(&pages[page][column], data, length);
+    bytesWritten += length;
+}
+
+void HostDisplay::clear() {
+    memset(pages, 0, sizeof(pages));
+    text.clear();
+}
+
+void HostDisplay::print(const char *text) {
+    this->text += text;
+}
+
+void HostDisplay::print(int number) {
+    text += std::to_string(number);
+}
+
+void HostDisplay::update() {
+    updates++;
+}
+
+bool HostDisplay::isPixelOn(int x, int y) const {
+    return (pages[y / 8][x] >> (y % 8)) & 1;
+}
+
+const std::string &HostDisplay::getText() const {
+    return text;
+}
+
+unsigned long HostDisplay::getUpdates() const {
+    return updates;
+}
+
+unsigned long HostDisplay::getBytesWritten() const {
+    return bytesWritten;
+}
+
+HostInput::HostInput() : held(0) {}
+
+uint16_t HostInput::scan() {
+    return held;
+}
+
+void HostInput::press(char key) {
+    held |= 1 << (key & 0xF);
+}
+
+void HostInput::release(char key) {
+    held &= ~(1 << (key & 0xF));
+}
+
+HostAudio::HostAudio() : playing(false) {}
+
+void HostAudio::play() {
+    playing = true;
+}
+
+void HostAudio::mute() {
+    playing = false;
+}
+
+bool HostAudio::isPlaying() const {
+    return playing;
+}
+
+bool HostStorage::begin() {
+    return true;
+}
+
+int HostStorage::read(const char *name, byte *buffer, int length) {
+    FILE *file = fopen(name, "rb");
+    if (!file) {
+        return -1;
+    }
+    int n = (int)fread(buffer, 1, length, file);
+    fclose(file);
+    return n;
+}
+
+int HostStorage::write(const char *name, const byte *buffer, int length) {
+    FILE *file = fopen(name, "wb");
+    if (!file) {
+        return -1;
+    }
+    int n = (int)fwrite(buffer, 1, length, file);
+    fclose(file);
+    return n;
+}
+
+// Time the host clock counts from
+static const std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+
+uint32_t HostClock::millis() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now() - clockStart).count();
+}
+
+uint32_t HostClock::micros() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now() - clockStart).count();
+}
+
+uint32_t HostClock::cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<nanoseconds>(steady_clock::now() - clockStart).count();
+#endif
+}
+
+void HostClock::delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/**
+ * @return Nanoseconds since host clock start
+ */
+static uint64_t nanosSinceStart() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now() - clockStart).count();
+}
+
+HostFrameTimer::HostFrameTimer() : period(0), next(0), callback(NULL), context(NULL) {}
+
+void HostFrameTimer::begin(uint32_t hz, void (*callback)(void *context), void *context) {
+    period = 1000000000ULL / hz;
+    next = nanosSinceStart() + period;
+    this->callback = callback;
+    this->context = context;
+}
+
+void HostFrameTimer::poll() {
+    if (!callback) {
+        return;
+    }
+    uint64_t t = nanosSinceStart();
+    while (t >= next) {
+        next += period;
+        callback(context);
+    }
+}
+
+void HostFrameTimer::idle() {
+    if (!callback) {
+        return;
+    }
+    uint64_t t = nanosSinceStart();
+    if (t < next) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(next - t));
+    }
+}
+
+HostLog::HostLog(FILE *stream) : stream(stream) {}
+
+void HostLog::print(const char *text) {
+    fputs(text, stream);
+}
+
+HostRng::HostRng(uint32_t initial) : initial(initial), state(initial) {}
+
+void HostRng::seed() {
+    state = initial ? initial : 1;
+}
+
+long HostRng::random(long max) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return max > 0 ? (long)(state % (uint32_t)max) : 0;
+}
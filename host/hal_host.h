@@ -0,0 +1,184 @@
+#ifndef HAL_HOST_H_INCLUDED
+#define HAL_HOST_H_INCLUDED
+
+#include <string>
+
+#include "../hal.h"
+
+#define HOST_PANEL_WIDTH 128
+#define HOST_PANEL_HEIGHT 64
+
+/**
+ * In-memory display, keeps panel contents and counts updates.
+ */
+class HostDisplay : public Display {
+    private:
+        // Panel memory, one byte per column of each 8 pixel page
+        byte pages[HOST_PANEL_HEIGHT / 8][HOST_PANEL_WIDTH];
+        // Text printed since last clear
+        std::string text;
+        // Number of update() calls
+        unsigned long updates;
+        // Number of bytes sent to the panel by writePage()
+        unsigned long bytesWritten;
+
+    public:
+        HostDisplay();
+
+        void begin();
+        void writePage(int page, int column, const byte *data, int length);
+        void clear();
+        void print(const char *text);
+        void print(int number);
+        void update();
+
+        /**
+         * @return <code>true</code> if panel pixel is on
+         */
+        bool isPixelOn(int x, int y) const;
+
+        /**
+         * @return Text printed since last clear
+         */
+        const std::string &getText() const;
+
+        /**
+         * @return Number of panel updates
+         */
+        unsigned long getUpdates() const;
+
+        /**
+         * @return Number of bytes sent to the panel by writePage()
+         */
+        unsigned long getBytesWritten() const;
+};
+
+/**
+ * Scripted keypad, keys are set by the host program.
+ */
+class HostInput : public Input {
+    private:
+        // Keys currently held, bit N set if key N is down
+        uint16_t held;
+
+    public:
+        HostInput();
+
+        uint16_t scan();
+
+        /**
+         * Presses given key and holds it until release().
+         *
+         * @param key Key to be pressed, 0-F
+         */
+        void press(char key);
+
+        /**
+         * Releases given key.
+         *
+         * @param key Key to be released, 0-F
+         */
+        void release(char key);
+};
+
+/**
+ * Buzzer that only remembers its state.
+ */
+class HostAudio : public Audio {
+    private:
+        bool playing;
+
+    public:
+        HostAudio();
+
+        void play();
+        void mute();
+
+        /**
+         * @return <code>true</code> if tone is playing
+         */
+        bool isPlaying() const;
+};
+
+/**
+ * Storage backed by the host file system.
+ */
+class HostStorage : public Storage {
+    public:
+        bool begin();
+        int read(const char *name, byte *buffer, int length);
+        int write(const char *name, const byte *buffer, int length);
+};
+
+/**
+ * Monotonic host clock.
+ */
+class HostClock : public Clock {
+    public:
+        uint32_t millis();
+        uint32_t micros();
+        uint32_t cycles();
+        void delay(uint32_t ms);
+};
+
+/**
+ * Frame timer driven from the monotonic host clock by poll().
+ */
+class HostFrameTimer : public FrameTimer {
+    private:
+        // Length of a period (ns)
+        uint64_t period;
+        // Time of next call (ns since clock start)
+        uint64_t next;
+        void (*callback)(void *context);
+        void *context;
+
+    public:
+        HostFrameTimer();
+
+        void begin(uint32_t hz, void (*callback)(void *context), void *context);
+        void poll();
+        void idle();
+};
+
+/**
+ * Log written to a stdio stream.
+ */
+class HostLog : public Log {
+    private:
+        FILE *stream;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param stream Stream to write to
+         */
+        HostLog(FILE *stream);
+
+        void print(const char *text);
+};
+
+/**
+ * Seedable pseudo random generator.
+ */
+class HostRng : public Rng {
+    private:
+        // Value generator is seeded with
+        uint32_t initial;
+        // Generator state
+        uint32_t state;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param initial Value generator is seeded with
+         */
+        HostRng(uint32_t initial = 1);
+
+        void seed();
+        long random(long max);
+};
+
+#endif
@@ -0,0 +1,320 @@
+#include "jit.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+// Longest code emitted for one instruction
+#define MAX_INSTRUCTION_CODE 24
+
+/**
+ * Appends machine code to a buffer.
+ */
+class Emitter {
+    private:
+        byte *out;
+
+    public:
+        Emitter(byte *out) : out(out) {}
+
+        void emit(byte b) {
+            *out++ = b;
+        }
+
+        void emit32(uint32_t value) {
+            for (int i = 0; i < 4; i++) {
+                emit((byte)(value >> (8 * i)));
+            }
+        }
+
+        byte *position() {
+            return out;
+        }
+
+        // op [rdi + reg], ... with 8 bit displacement
+        void regVOperand(byte opcode, int digit, int reg) {
+            emit(opcode);
+            emit((byte)(0x47 | (digit << 3)));
+            emit((byte)reg);
+        }
+
+        // mov al, [rdi + reg]
+        void loadAl(int reg) {
+            regVOperand(0x8A, 0, reg);
+        }
+
+        // mov cl, [rdi + reg]
+        void loadCl(int reg) {
+            regVOperand(0x8A, 1, reg);
+        }
+
+        // op al, cl
+        void operateAlCl(byte opcode) {
+            emit(opcode);
+            emit(0xC8);
+        }
+
+        // setcc dl; mov [rdi + reg], al; mov [rdi + 15], dl
+        void storeAlAndFlag(int reg, byte setccOpcode) {
+            emit(0x0F);
+            emit(setccOpcode);
+            emit(0xC2);
+            regVOperand(0x88, 0, reg);
+            regVOperand(0x88, 2, 0xF);
+        }
+
+        // mov eax, value; ret
+        void returnValue(int value) {
+            emit(0xB8);
+            emit32((uint32_t)value);
+            emit(0xC3);
+        }
+
+        // eax = condition ? skip : next; ret
+        void returnConditional(byte cmovOpcode, int next, int skip) {
+            emit(0xB8);
+            emit32((uint32_t)next);
+            emit(0xBA);
+            emit32((uint32_t)skip);
+            emit(0x0F);
+            emit(cmovOpcode);
+            emit(0xC2);
+            emit(0xC3);
+        }
+};
+
+// Second byte of cmove eax, edx and cmovne eax, edx
+#define CMOVE 0x44
+#define CMOVNE 0x45
+// Second byte of setb dl and setae dl
+#define SETB 0x92
+#define SETAE 0x93
+
+Jit::Jit(CPU &cpu, Memory &memory) : cpu(cpu), memory(memory) {
+    void *buffer = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    code = buffer == MAP_FAILED ? NULL : (byte *)buffer;
+    blocksCompiled = 0;
+    blockRuns = 0;
+    interpreted = 0;
+    flush();
+    memory.addObserver(this);
+}
+
+Jit::~Jit() {
+    if (code) {
+        munmap(code, CODE_BUFFER_SIZE);
+    }
+}
+
+bool Jit::isAvailable() {
+    return code != NULL;
+}
+
+void Jit::flush() {
+    memset(blocks, 0, sizeof(blocks));
+    used = 0;
+    quirks = cpu.getQuirks();
+}
+
+void Jit::compile(int pc, Block &block) {
+    if (used + (MAX_BLOCK_LENGTH + 1) * MAX_INSTRUCTION_CODE > CODE_BUFFER_SIZE) {
+        flush();
+    }
+
+    byte *start = code + used;
+    Emitter e(start);
+    int length = 0;
+    int location = pc;
+    bool terminated = false;
+
+    while (length < MAX_BLOCK_LENGTH && location + 1 < MEMORY_SIZE && !terminated) {
+        Instruction in;
+        DecodeCache::decode((memory.getByte(location) << 8) | memory.getByte(location + 1), in);
+        int next = location + 2;
+
+        switch (in.op) {
+            case OP_NOP:
+                break;
+            case OP_SET_VALUE:
+                // mov byte [rdi + x], nn
+                e.regVOperand(0xC6, 0, in.x);
+                e.emit(in.nn);
+                break;
+            case OP_ADD_VALUE:
+                // add byte [rdi + x], nn
+                e.regVOperand(0x80, 0, in.x);
+                e.emit(in.nn);
+                break;
+            case OP_MOVE:
+                e.loadAl(in.y);
+                e.regVOperand(0x88, 0, in.x);
+                break;
+            case OP_OR:
+            case OP_AND:
+            case OP_XOR:
+                // or, and, xor [rdi + x], al
+                e.loadAl(in.y);
+                e.regVOperand(in.op == OP_OR ? 0x08 : in.op == OP_AND ? 0x20 : 0x30, 0, in.x);
+                if (quirks & QUIRK_VF_RESET) {
+                    // mov byte [rdi + 15], 0
+                    e.regVOperand(0xC6, 0, 0xF);
+                    e.emit(0);
+                }
+                break;
+            // Flag setting instructions follow CPU: the result is
+            // computed in al and the flag taken from the carry, VF is
+            // written last
+            case OP_ADD:
+                // add al, cl
+                e.loadAl(in.x);
+                e.loadCl(in.y);
+                e.operateAlCl(0x00);
+                e.storeAlAndFlag(in.x, SETB);
+                break;
+            case OP_SUB_N:
+                // sub al, cl
+                e.loadAl(in.x);
+                e.loadCl(in.y);
+                e.operateAlCl(0x28);
+                e.storeAlAndFlag(in.x, SETAE);
+                break;
+            case OP_SUB:
+                // sub al, cl with the operands swapped
+                e.loadAl(in.y);
+                e.loadCl(in.x);
+                e.operateAlCl(0x28);
+                e.storeAlAndFlag(in.x, SETAE);
+                break;
+            case OP_SHIFT_RIGHT:
+                // shr al, 1
+                e.loadAl(quirks & QUIRK_SHIFT_VY ? in.y : in.x);
+                e.emit(0xD0);
+                e.emit(0xE8);
+                e.storeAlAndFlag(in.x, SETB);
+                break;
+            case OP_SHIFT_LEFT:
+                // shl al, 1
+                e.loadAl(quirks & QUIRK_SHIFT_VY ? in.y : in.x);
+                e.emit(0xD0);
+                e.emit(0xE0);
+                e.storeAlAndFlag(in.x, SETB);
+                break;
+            case OP_SET_I:
+                // mov dword [rsi], nnn
+                e.emit(0xC7);
+                e.emit(0x06);
+                e.emit32(in.nnn);
+                break;
+            case OP_ADD_TO_I:
+                // movzx eax, byte [rdi + x]; add [rsi], eax
+                e.emit(0x0F);
+                e.regVOperand(0xB6, 0, in.x);
+                e.emit(0x01);
+                e.emit(0x06);
+                break;
+            case OP_JUMP:
+                e.returnValue(in.nnn);
+                terminated = true;
+                break;
+            case OP_SKIP_EQUAL_VALUE:
+            case OP_SKIP_NOT_EQUAL_VALUE:
+                // cmp byte [rdi + x], nn
+                e.regVOperand(0x80, 7, in.x);
+                e.emit(in.nn);
+                e.returnConditional(in.op == OP_SKIP_EQUAL_VALUE ? CMOVE : CMOVNE, next, next + 2);
+                terminated = true;
+                break;
+            case OP_SKIP_EQUAL_REGISTER:
+            case OP_SKIP_NOT_EQUAL_REGISTER:
+                // cmp [rdi + x], al
+                e.loadAl(in.y);
+                e.regVOperand(0x38, 0, in.x);
+                e.returnConditional(in.op == OP_SKIP_EQUAL_REGISTER ? CMOVE : CMOVNE, next, next + 2);
+                terminated = true;
+                break;
+            default:
+                // Left to the interpreter
+                goto done;
+        }
+        length++;
+        location = next;
+    }
+done:
+
+    block.valid = true;
+    block.length = length;
+    // Instruction that ended the block counts too, when it changes the block may grow
+    block.size = location - pc + (terminated ? 0 : 2);
+    if (length == 0) {
+        block.code = NULL;
+        return;
+    }
+    if (!terminated) {
+        e.returnValue(location);
+    }
+    block.code = (Code)start;
+    used += e.position() - start;
+    blocksCompiled++;
+}
+
+int Jit::run(int count) {
+    if (!code) {
+        int executed = cpu.run(count);
+        interpreted += executed;
+        return executed;
+    }
+
+    if (cpu.getQuirks() != quirks) {
+        flush();
+    }
+    const int total = count;
+    while (count > 0) {
+        int pc = cpu.pc;
+        if (pc >= 0 && pc < MEMORY_SIZE) {
+            Block &block = blocks[pc];
+            if (!block.valid) {
+                compile(pc, block);
+            }
+            if (block.code && block.length <= count) {
+                cpu.pc = block.code(cpu.regV, &cpu.regI);
+                count -= block.length;
+                blockRuns++;
+                continue;
+            }
+        }
+        cpu.executeNextCommand();
+        count--;
+        interpreted++;
+        if (cpu.isWaitingForKey()) {
+            return total - count;
+        }
+    }
+    return total - count;
+}
+
+void Jit::onMemoryWrite(int location, int length) {
+    if (length > MAX_BLOCK_SIZE) {
+        flush();
+        return;
+    }
+    int first = location - MAX_BLOCK_SIZE + 1;
+    if (first < 0) {
+        first = 0;
+    }
+    for (int pc = first; pc < location + length && pc < MEMORY_SIZE; pc++) {
+        if (blocks[pc].valid && pc + blocks[pc].size > location) {
+            blocks[pc].valid = false;
+        }
+    }
+}
+
+unsigned long Jit::getBlocksCompiled() {
+    return blocksCompiled;
+}
+
+unsigned long Jit::getBlockRuns() {
+    return blockRuns;
+}
+
+unsigned long Jit::getInterpreted() {
+    return interpreted;
+}
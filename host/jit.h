@@ -0,0 +1,113 @@
+#ifndef JIT_H_INCLUDED
+#define JIT_H_INCLUDED
+
+#include <stddef.h>
+
+#include "../cpu.h"
+
+// Maximal number of instructions in a block
+#define MAX_BLOCK_LENGTH 32
+// Maximal number of bytes a block depends on, including the instruction ending it
+#define MAX_BLOCK_SIZE (MAX_BLOCK_LENGTH * 2 + 2)
+// Size of executable memory blocks are emitted to
+#define CODE_BUFFER_SIZE (1 << 20)
+
+/**
+ * Basic-block translator from CHIP-8 to x86-64.
+ *
+ * Straight-line runs of register instructions (6XNN, 7XNN, 8XYN,
+ * ANNN, FX1E, unknown opcodes) are compiled into native code, ending
+ * with a jump or skip (1NNN, 3XNN, 4XNN, 5XY0, 9XY0) when one follows.
+ * Everything else, including calls and DXYN, is left to the CPU's
+ * interpreter. Blocks are cached by start address and dropped when
+ * memory they were translated from is written to. Code follows the
+ * quirks of the CPU's profile, blocks are dropped when it changes.
+ */
+class Jit : public Engine, public MemoryObserver {
+    private:
+        /**
+         * Compiled block, returns location of next instruction.
+         */
+        typedef int (*Code)(byte *regV, int *regI);
+
+        /**
+         * Cached translation of a block.
+         */
+        struct Block {
+            // Native code, NULL if first instruction can not be translated
+            Code code;
+            // Number of instructions in the block
+            int length;
+            // Number of bytes of memory the block was translated from
+            int size;
+            // Entry holds a translation
+            bool valid;
+        };
+
+        CPU &cpu;
+        Memory &memory;
+
+        // Blocks by start address
+        Block blocks[MEMORY_SIZE];
+
+        // Executable memory and number of bytes used
+        byte *code;
+        size_t used;
+        // Quirk flags blocks were translated for
+        byte quirks;
+
+        // Counters
+        unsigned long blocksCompiled;
+        unsigned long blockRuns;
+        unsigned long interpreted;
+
+        /**
+         * Translates block starting at given location.
+         *
+         * @param pc Location of first instruction
+         * @param block Output
+         */
+        void compile(int pc, Block &block);
+
+        /**
+         * Drops all blocks and emitted code.
+         */
+        void flush();
+
+    public:
+        /**
+         * Default constructor. Registers translator as memory observer.
+         *
+         * @param cpu CPU whose registers are worked on
+         * @param memory Memory instructions are read from
+         */
+        Jit(CPU &cpu, Memory &memory);
+
+        ~Jit();
+
+        /**
+         * @return <code>true</code> if executable memory could be allocated
+         */
+        bool isAvailable();
+
+        int run(int count);
+
+        void onMemoryWrite(int location, int length);
+
+        /**
+         * @return Number of blocks translated
+         */
+        unsigned long getBlocksCompiled();
+
+        /**
+         * @return Number of compiled blocks run
+         */
+        unsigned long getBlockRuns();
+
+        /**
+         * @return Number of instructions left to the interpreter
+         */
+        unsigned long getInterpreted();
+};
+
+#endif
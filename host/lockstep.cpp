@@ -0,0 +1,720 @@
+#include "lockstep.h"
+
+#include <string.h>
+
+#include "hal_host.h"
+#include "../cpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOCKSTEP_AVX2 1
+#include <immintrin.h>
+#else
+#define LOCKSTEP_AVX2 0
+#endif
+
+Lockstep::Lockstep(int lanes, int instructionsPerFrame, bool vector) :
+    lanes(lanes),
+    stride((lanes + LOCKSTEP_CHUNK - 1) / LOCKSTEP_CHUNK * LOCKSTEP_CHUNK),
+    instructionsPerFrame(instructionsPerFrame),
+    avx2(vector && hasAvx2()),
+    regV(NUM_REGISTERS * stride),
+    regI(stride),
+    pc(stride),
+    regStack(stride),
+    stack((size_t)stride * STACK_SIZE),
+    timerDelay(stride),
+    timerSound(stride),
+    rngState(stride, 1),
+    mem((size_t)stride * MEMORY_SIZE),
+    screen((size_t)stride * LOCKSTEP_HEIGHT),
+    ownCode(stride),
+    keys(stride),
+    previousKeys(stride),
+    pressEvents(stride),
+    releaseEvents(stride),
+    waitingForKey(stride),
+    waitedKey(stride),
+    group(stride),
+    pending(stride),
+    active(stride),
+    activeLanes(0),
+    draws(stride),
+    instructions(stride),
+    frames(0),
+    groupSteps(0),
+    laneSteps(0) {
+    loadRom(NULL, 0);
+}
+
+bool Lockstep::hasAvx2() {
+#if LOCKSTEP_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool Lockstep::loadRom(const byte *rom, int length) {
+    // Memory lays out fonts and ROM the same way the CPU sees them
+    byte initial[MEMORY_SIZE] = {0};
+    HostStorage storage;
+    Memory memory(storage, initial);
+    if (!memory.loadRom(rom, length)) {
+        return false;
+    }
+    memcpy(image, initial, sizeof(image));
+    memset(code, 0, sizeof(code));
+    memset(decodedValid, 0, sizeof(decodedValid));
+
+    for (int lane = 0; lane < stride; lane++) {
+        memcpy(laneMemory(lane), image, MEMORY_SIZE);
+        for (int r = 0; r < NUM_REGISTERS; r++) {
+            reg(lane, r) = 0;
+        }
+        pc[lane] = PC_START;
+        regStack[lane] = 0;
+        regI[lane] = 0;
+        timerDelay[lane] = 0;
+        timerSound[lane] = 0;
+        ownCode[lane] = 0;
+        keys[lane] = 0;
+        previousKeys[lane] = 0;
+        pressEvents[lane] = 0;
+        releaseEvents[lane] = 0;
+        waitingForKey[lane] = 0;
+        waitedKey[lane] = NO_KEY_PRESSED;
+        active[lane] = 0;
+        draws[lane] = 0;
+        instructions[lane] = 0;
+    }
+    memset(stack.data(), 0, stack.size() * sizeof(uint16_t));
+    memset(screen.data(), 0, screen.size() * sizeof(uint64_t));
+    frames = 0;
+    groupSteps = 0;
+    laneSteps = 0;
+    return true;
+}
+
+void Lockstep::seed(int lane, uint32_t seed) {
+    rngState[lane] = seed ? seed : 1;
+}
+
+void Lockstep::setKeys(int lane, uint16_t mask) {
+    keys[lane] = mask;
+}
+
+void Lockstep::checkCode(int location) {
+    for (int i = location; i < location + 2 && i < MEMORY_SIZE; i++) {
+        if (code[i]) {
+            continue;
+        }
+        code[i] = 1;
+        for (int lane = 0; lane < lanes; lane++) {
+            if (laneMemory(lane)[i] != image[i]) {
+                ownCode[lane] = 1;
+            }
+        }
+    }
+}
+
+bool Lockstep::waitForKey(int lane, int r) {
+    if (!waitingForKey[lane]) {
+        // Only presses after the instruction count
+        pressEvents[lane] = 0;
+        releaseEvents[lane] = 0;
+        waitingForKey[lane] = 1;
+        waitedKey[lane] = NO_KEY_PRESSED;
+    }
+    // Events of one scan are queued in key order
+    for (int key = 0; key < NUM_KEYS; key++) {
+        uint16_t bit = 1 << key;
+        if (pressEvents[lane] & bit) {
+            if (waitedKey[lane] == NO_KEY_PRESSED) {
+                waitedKey[lane] = key;
+            }
+        } else if ((releaseEvents[lane] & bit) && key == waitedKey[lane]) {
+            // Later events stay queued
+            uint16_t consumed = (bit << 1) - 1;
+            pressEvents[lane] &= ~consumed;
+            releaseEvents[lane] &= ~consumed;
+            reg(lane, r) = (byte)key;
+            waitingForKey[lane] = 0;
+            return true;
+        }
+    }
+    pressEvents[lane] = 0;
+    releaseEvents[lane] = 0;
+    pc[lane] -= 2;
+    active[lane] = 0;
+    activeLanes--;
+    return false;
+}
+
+void Lockstep::execute(int lane, const Instruction &instruction) {
+    int x = instruction.x;
+    int y = instruction.y;
+    byte &vx = reg(lane, x);
+    byte &vf = reg(lane, 0xF);
+
+    switch (instruction.op) {
+        case OP_NOP:
+            break;
+        case OP_CLEAR_SCREEN:
+            memset(&screen[(size_t)lane * LOCKSTEP_HEIGHT], 0, LOCKSTEP_HEIGHT * sizeof(uint64_t));
+            break;
+        case OP_RETURN:
+            regStack[lane] = (regStack[lane] - 1) & (STACK_SIZE - 1);
+            pc[lane] = stack[(size_t)lane * STACK_SIZE + regStack[lane]];
+            break;
+        case OP_JUMP:
+            pc[lane] = instruction.nnn;
+            break;
+        case OP_CALL:
+            stack[(size_t)lane * STACK_SIZE + regStack[lane]] = pc[lane];
+            regStack[lane] = (regStack[lane] + 1) & (STACK_SIZE - 1);
+            pc[lane] = instruction.nnn;
+            break;
+        case OP_SKIP_EQUAL_VALUE:
+            if (vx == instruction.nn) {
+                pc[lane] += 2;
+            }
+            break;
+        case OP_SKIP_NOT_EQUAL_VALUE:
+            if (vx != instruction.nn) {
+                pc[lane] += 2;
+            }
+            break;
+        case OP_SKIP_EQUAL_REGISTER:
+            if (vx == reg(lane, y)) {
+                pc[lane] += 2;
+            }
+            break;
+        case OP_SET_VALUE:
+            vx = instruction.nn;
+            break;
+        case OP_ADD_VALUE:
+            vx += instruction.nn;
+            break;
+        case OP_MOVE:
+            vx = reg(lane, y);
+            break;
+        case OP_OR:
+            vx |= reg(lane, y);
+            break;
+        case OP_AND:
+            vx &= reg(lane, y);
+            break;
+        case OP_XOR:
+            vx ^= reg(lane, y);
+            break;
+        // Flag is stored after the result, as CPU does when X is F
+        case OP_ADD: {
+            int sum = vx + reg(lane, y);
+            vx = (byte)sum;
+            vf = sum > 0xFF;
+            break;
+        }
+        case OP_SUB_N: {
+            byte flag = vx >= reg(lane, y);
+            vx -= reg(lane, y);
+            vf = flag;
+            break;
+        }
+        case OP_SHIFT_RIGHT: {
+            byte flag = vx & 0x01;
+            vx >>= 1;
+            vf = flag;
+            break;
+        }
+        case OP_SUB: {
+            byte flag = reg(lane, y) >= vx;
+            vx = reg(lane, y) - vx;
+            vf = flag;
+            break;
+        }
+        case OP_SHIFT_LEFT: {
+            byte flag = vx >> 7;
+            vx <<= 1;
+            vf = flag;
+            break;
+        }
+        case OP_SKIP_NOT_EQUAL_REGISTER:
+            if (vx != reg(lane, y)) {
+                pc[lane] += 2;
+            }
+            break;
+        case OP_SET_I:
+            regI[lane] = instruction.nnn;
+            break;
+        case OP_JUMP_PLUS_V0:
+            pc[lane] = (instruction.nnn + reg(lane, 0)) & 0x0FFF;
+            break;
+        case OP_RANDOM: {
+            // CPU::setRegisterToRandomValue()
+            uint32_t state = rngState[lane];
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            rngState[lane] = state;
+            vx = (byte)(instruction.nn & (state % 0xFF));
+            break;
+        }
+        case OP_DRAW: {
+            draws[lane]++;
+            vf = 0;
+            int left = reg(lane, x) % LOCKSTEP_WIDTH;
+            int top = reg(lane, y);
+            uint64_t *rows = &screen[(size_t)lane * LOCKSTEP_HEIGHT];
+            for (int j = 0; j < instruction.n; j++) {
+                byte sprite = getByte(lane, regI[lane] + j);
+                if (sprite == 0) {
+                    continue;
+                }
+                uint64_t bits = (uint64_t)sprite << 56;
+                if (left != 0) {
+                    bits = (bits >> left) | (bits << (64 - left));
+                }
+                uint64_t &row = rows[(top + j) % LOCKSTEP_HEIGHT];
+                if (row & bits) {
+                    vf = 1;
+                }
+                row ^= bits;
+            }
+            break;
+        }
+        case OP_SKIP_KEY_PRESSED:
+            if ((keys[lane] >> (vx & 0xF)) & 1) {
+                pc[lane] += 2;
+            }
+            break;
+        case OP_SKIP_KEY_NOT_PRESSED:
+            if (!((keys[lane] >> (vx & 0xF)) & 1)) {
+                pc[lane] += 2;
+            }
+            break;
+        case OP_GET_DELAY_TIMER:
+            vx = timerDelay[lane];
+            break;
+        case OP_WAIT_FOR_KEY:
+            waitForKey(lane, x);
+            break;
+        case OP_SET_DELAY_TIMER:
+            timerDelay[lane] = vx;
+            break;
+        case OP_SET_SOUND_TIMER:
+            timerSound[lane] = vx;
+            break;
+        case OP_ADD_TO_I:
+            regI[lane] += vx;
+            break;
+        case OP_LOAD_SPRITE:
+            regI[lane] = vx * 5;
+            break;
+        case OP_STORE_DECIMAL:
+            setByte(lane, regI[lane], vx / 100);
+            setByte(lane, regI[lane] + 1, (vx % 100) / 10);
+            setByte(lane, regI[lane] + 2, (vx % 100) % 10);
+            break;
+        case OP_STORE_REGISTERS:
+            for (int i = 0; i <= x; i++) {
+                setByte(lane, regI[lane] + i, reg(lane, i));
+            }
+            break;
+        case OP_LOAD_REGISTERS:
+            for (int i = 0; i <= x; i++) {
+                reg(lane, i) = getByte(lane, regI[lane] + i);
+            }
+            break;
+    }
+}
+
+void Lockstep::step(int lane) {
+    Instruction instruction;
+    DecodeCache::decode((getByte(lane, pc[lane]) << 8) | getByte(lane, pc[lane] + 1), instruction);
+    pc[lane] += 2;
+    execute(lane, instruction);
+    instructions[lane]++;
+    laneSteps++;
+}
+
+void Lockstep::runGroup(const Instruction &instruction) {
+    for (int lane = 0; lane < lanes; lane++) {
+        instructions[lane] += group[lane] & 1;
+    }
+    if (avx2 && runGroupAvx2(instruction)) {
+        return;
+    }
+    for (int lane = 0; lane < lanes; lane++) {
+        if (group[lane]) {
+            pc[lane] += 2;
+            execute(lane, instruction);
+        }
+    }
+}
+
+int Lockstep::selectGroup(int location) {
+    if (avx2) {
+        return selectGroupAvx2(location);
+    }
+    int selected = 0;
+    for (int lane = 0; lane < stride; lane++) {
+        byte in = pending[lane] && !ownCode[lane] && pc[lane] == location ? 0xFF : 0;
+        group[lane] = in;
+        pending[lane] &= ~in;
+        selected += in & 1;
+    }
+    return selected;
+}
+
+void Lockstep::runStep() {
+    memcpy(pending.data(), active.data(), stride);
+    int left = activeLanes;
+
+    int lane = 0;
+    for (int groups = 0; groups < LOCKSTEP_MAX_GROUPS && left > 0; groups++) {
+        while (lane < lanes && (!pending[lane] || ownCode[lane])) {
+            lane++;
+        }
+        if (lane == lanes) {
+            break;
+        }
+        int location = pc[lane];
+        Instruction instruction;
+        if (location >= 0 && location + 1 < MEMORY_SIZE) {
+            if (!decodedValid[location]) {
+                checkCode(location);
+                DecodeCache::decode((image[location] << 8) | image[location + 1], decoded[location]);
+                decodedValid[location] = 1;
+                if (ownCode[lane]) {
+                    continue;
+                }
+            }
+            instruction = decoded[location];
+        } else {
+            // Past the end of memory every lane reads zeros
+            DecodeCache::decode(0, instruction);
+        }
+        int selected = selectGroup(location);
+        groupSteps += selected;
+        left -= selected;
+        runGroup(instruction);
+    }
+
+    // Lanes that diverged, or modified their code
+    for (lane = 0; lane < lanes && left > 0; lane++) {
+        if (pending[lane]) {
+            step(lane);
+            left--;
+        }
+    }
+}
+
+void Lockstep::runFrame() {
+    // Keyboard::scan() without debouncing
+    for (int lane = 0; lane < lanes; lane++) {
+        uint16_t changed = keys[lane] ^ previousKeys[lane];
+        if (changed == 0xFFFF) {
+            // Event queue holds one less than NUM_KEYS, oldest is dropped
+            changed &= ~1;
+        }
+        pressEvents[lane] = keys[lane] & changed;
+        releaseEvents[lane] = previousKeys[lane] & changed;
+        previousKeys[lane] = keys[lane];
+        active[lane] = 0xFF;
+    }
+    activeLanes = lanes;
+
+    for (int i = 0; i < instructionsPerFrame; i++) {
+        runStep();
+    }
+
+    for (int lane = 0; lane < lanes; lane++) {
+        if (timerSound[lane] > 0) {
+            timerSound[lane]--;
+        }
+        if (timerDelay[lane] > 0) {
+            timerDelay[lane]--;
+        }
+    }
+    frames++;
+}
+
+#if LOCKSTEP_AVX2
+
+/**
+ * Stores bytes of value where mask is set, keeps the others.
+ */
+__attribute__((target("avx2")))
+static inline void storeMasked(byte *to, __m128i value, __m128i mask) {
+    __m128i old = _mm_loadu_si128((const __m128i *)to);
+    _mm_storeu_si128((__m128i *)to, _mm_blendv_epi8(old, value, mask));
+}
+
+/**
+ * Stores 32-bit values where mask is set, keeps the others.
+ */
+__attribute__((target("avx2")))
+static inline void storeMasked(int32_t *to, __m256i value, __m256i mask) {
+    __m256i old = _mm256_loadu_si256((const __m256i *)to);
+    _mm256_storeu_si256((__m256i *)to, _mm256_blendv_epi8(old, value, mask));
+}
+
+__attribute__((target("avx2")))
+static inline __m128i loadBytes(const byte *from) {
+    return _mm_loadu_si128((const __m128i *)from);
+}
+
+__attribute__((target("avx2")))
+bool Lockstep::runGroupAvx2(const Instruction &instruction) {
+    switch (instruction.op) {
+        case OP_CLEAR_SCREEN:
+        case OP_RETURN:
+        case OP_CALL:
+        case OP_RANDOM:
+        case OP_DRAW:
+        case OP_WAIT_FOR_KEY:
+        case OP_STORE_DECIMAL:
+        case OP_STORE_REGISTERS:
+        case OP_LOAD_REGISTERS:
+            // Lane memory, screen or RNG, run lane by lane
+            return false;
+    }
+
+    byte *vx = &regV[instruction.x * stride];
+    byte *vy = &regV[instruction.y * stride];
+    byte *vf = &regV[0xF * stride];
+    byte *v0 = &regV[0];
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char)0xFF);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i nn = _mm_set1_epi8((char)instruction.nn);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i nnn = _mm256_set1_epi32(instruction.nnn);
+
+    for (int c = 0; c < stride; c += LOCKSTEP_CHUNK) {
+        __m128i mask = loadBytes(&group[c]);
+        if (_mm_testz_si128(mask, mask)) {
+            continue;
+        }
+        __m256i maskLow = _mm256_cvtepi8_epi32(mask);
+        __m256i maskHigh = _mm256_cvtepi8_epi32(_mm_srli_si128(mask, 8));
+        __m256i pcLow = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&pc[c]), two);
+        __m256i pcHigh = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&pc[c + 8]), two);
+        // Lanes skipping next instruction, 0xFF if set
+        __m128i skip = zero;
+        __m128i a;
+        __m128i b;
+
+        switch (instruction.op) {
+            case OP_JUMP:
+                pcLow = nnn;
+                pcHigh = nnn;
+                break;
+            case OP_SKIP_EQUAL_VALUE:
+                skip = _mm_cmpeq_epi8(loadBytes(&vx[c]), nn);
+                break;
+            case OP_SKIP_NOT_EQUAL_VALUE:
+                skip = _mm_xor_si128(_mm_cmpeq_epi8(loadBytes(&vx[c]), nn), ones);
+                break;
+            case OP_SKIP_EQUAL_REGISTER:
+                skip = _mm_cmpeq_epi8(loadBytes(&vx[c]), loadBytes(&vy[c]));
+                break;
+            case OP_SKIP_NOT_EQUAL_REGISTER:
+                skip = _mm_xor_si128(_mm_cmpeq_epi8(loadBytes(&vx[c]), loadBytes(&vy[c])), ones);
+                break;
+            case OP_SET_VALUE:
+                storeMasked(&vx[c], nn, mask);
+                break;
+            case OP_ADD_VALUE:
+                storeMasked(&vx[c], _mm_add_epi8(loadBytes(&vx[c]), nn), mask);
+                break;
+            case OP_MOVE:
+                storeMasked(&vx[c], loadBytes(&vy[c]), mask);
+                break;
+            case OP_OR:
+                storeMasked(&vx[c], _mm_or_si128(loadBytes(&vx[c]), loadBytes(&vy[c])), mask);
+                break;
+            case OP_AND:
+                storeMasked(&vx[c], _mm_and_si128(loadBytes(&vx[c]), loadBytes(&vy[c])), mask);
+                break;
+            case OP_XOR:
+                storeMasked(&vx[c], _mm_xor_si128(loadBytes(&vx[c]), loadBytes(&vy[c])), mask);
+                break;
+            // Flag is computed from the operands and stored after the
+            // result, as the scalar code does when X is F
+            case OP_ADD:
+                a = loadBytes(&vx[c]);
+                b = _mm_add_epi8(a, loadBytes(&vy[c]));
+                storeMasked(&vx[c], b, mask);
+                // Carry unless max(sum, a) == sum
+                storeMasked(&vf[c], _mm_andnot_si128(_mm_cmpeq_epi8(_mm_max_epu8(b, a), b), one), mask);
+                break;
+            case OP_SUB_N:
+                a = loadBytes(&vx[c]);
+                b = loadBytes(&vy[c]);
+                storeMasked(&vx[c], _mm_sub_epi8(a, b), mask);
+                // a >= b if max(a, b) == a
+                storeMasked(&vf[c], _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(a, b), a), one), mask);
+                break;
+            case OP_SUB:
+                a = loadBytes(&vx[c]);
+                b = loadBytes(&vy[c]);
+                storeMasked(&vx[c], _mm_sub_epi8(b, a), mask);
+                // b >= a if max(a, b) == b
+                storeMasked(&vf[c], _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(a, b), b), one), mask);
+                break;
+            case OP_SHIFT_RIGHT:
+                a = loadBytes(&vx[c]);
+                storeMasked(&vx[c], _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F)), mask);
+                storeMasked(&vf[c], _mm_and_si128(a, one), mask);
+                break;
+            case OP_SHIFT_LEFT:
+                a = loadBytes(&vx[c]);
+                storeMasked(&vx[c], _mm_add_epi8(a, a), mask);
+                storeMasked(&vf[c], _mm_and_si128(_mm_srli_epi16(a, 7), one), mask);
+                break;
+            case OP_SET_I:
+                storeMasked(&regI[c], nnn, maskLow);
+                storeMasked(&regI[c + 8], nnn, maskHigh);
+                break;
+            case OP_JUMP_PLUS_V0:
+                a = loadBytes(&v0[c]);
+                pcLow = _mm256_and_si256(_mm256_add_epi32(nnn, _mm256_cvtepu8_epi32(a)), _mm256_set1_epi32(0x0FFF));
+                pcHigh = _mm256_and_si256(_mm256_add_epi32(nnn, _mm256_cvtepu8_epi32(_mm_srli_si128(a, 8))),
+                    _mm256_set1_epi32(0x0FFF));
+                break;
+            case OP_SKIP_KEY_PRESSED:
+            case OP_SKIP_KEY_NOT_PRESSED: {
+                a = _mm_and_si128(loadBytes(&vx[c]), _mm_set1_epi8(0xF));
+                __m256i keysLow = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&keys[c]));
+                __m256i keysHigh = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&keys[c + 8]));
+                __m256i downLow = _mm256_and_si256(_mm256_srlv_epi32(keysLow, _mm256_cvtepu8_epi32(a)), _mm256_set1_epi32(1));
+                __m256i downHigh = _mm256_and_si256(_mm256_srlv_epi32(keysHigh, _mm256_cvtepu8_epi32(_mm_srli_si128(a, 8))),
+                    _mm256_set1_epi32(1));
+                if (instruction.op == OP_SKIP_KEY_NOT_PRESSED) {
+                    downLow = _mm256_xor_si256(downLow, _mm256_set1_epi32(1));
+                    downHigh = _mm256_xor_si256(downHigh, _mm256_set1_epi32(1));
+                }
+                pcLow = _mm256_add_epi32(pcLow, _mm256_slli_epi32(downLow, 1));
+                pcHigh = _mm256_add_epi32(pcHigh, _mm256_slli_epi32(downHigh, 1));
+                break;
+            }
+            case OP_GET_DELAY_TIMER:
+                storeMasked(&vx[c], loadBytes(&timerDelay[c]), mask);
+                break;
+            case OP_SET_DELAY_TIMER:
+                storeMasked(&timerDelay[c], loadBytes(&vx[c]), mask);
+                break;
+            case OP_SET_SOUND_TIMER:
+                storeMasked(&timerSound[c], loadBytes(&vx[c]), mask);
+                break;
+            case OP_ADD_TO_I:
+                a = loadBytes(&vx[c]);
+                storeMasked(&regI[c], _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&regI[c]), _mm256_cvtepu8_epi32(a)),
+                    maskLow);
+                storeMasked(&regI[c + 8], _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&regI[c + 8]),
+                    _mm256_cvtepu8_epi32(_mm_srli_si128(a, 8))), maskHigh);
+                break;
+            case OP_LOAD_SPRITE:
+                a = loadBytes(&vx[c]);
+                storeMasked(&regI[c], _mm256_mullo_epi32(_mm256_cvtepu8_epi32(a), _mm256_set1_epi32(5)), maskLow);
+                storeMasked(&regI[c + 8], _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(a, 8)), _mm256_set1_epi32(5)),
+                    maskHigh);
+                break;
+        }
+
+        pcLow = _mm256_add_epi32(pcLow, _mm256_and_si256(_mm256_cvtepi8_epi32(skip), two));
+        pcHigh = _mm256_add_epi32(pcHigh, _mm256_and_si256(_mm256_cvtepi8_epi32(_mm_srli_si128(skip, 8)), two));
+        storeMasked(&pc[c], pcLow, maskLow);
+        storeMasked(&pc[c + 8], pcHigh, maskHigh);
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+int Lockstep::selectGroupAvx2(int location) {
+    const __m256i at = _mm256_set1_epi32(location);
+    const __m128i zero = _mm_setzero_si128();
+    int selected = 0;
+    for (int c = 0; c < stride; c += LOCKSTEP_CHUNK) {
+        __m256i low = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&pc[c]), at);
+        __m256i high = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&pc[c + 8]), at);
+        // Packing works within 128-bit halves, permute restores lane order
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+        __m128i same = _mm_packs_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        __m128i waiting = loadBytes(&pending[c]);
+        __m128i shared = _mm_cmpeq_epi8(loadBytes(&ownCode[c]), zero);
+        __m128i in = _mm_and_si128(_mm_and_si128(same, waiting), shared);
+        _mm_storeu_si128((__m128i *)&group[c], in);
+        _mm_storeu_si128((__m128i *)&pending[c], _mm_andnot_si128(in, waiting));
+        selected += __builtin_popcount(_mm_movemask_epi8(in));
+    }
+    return selected;
+}
+
+#else
+
+bool Lockstep::runGroupAvx2(const Instruction &) {
+    return false;
+}
+
+int Lockstep::selectGroupAvx2(int location) {
+    return selectGroup(location);
+}
+
+#endif
+
+uint32_t Lockstep::hashScreen(int lane) {
+    uint32_t hash = 2166136261u;
+    const uint64_t *rows = &screen[(size_t)lane * LOCKSTEP_HEIGHT];
+    for (int y = 0; y < LOCKSTEP_HEIGHT; y++) {
+        for (int x = 0; x < LOCKSTEP_WIDTH; x += 8) {
+            hash = (hash ^ (byte)(rows[y] >> (56 - x))) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+byte Lockstep::getRegister(int lane, int r) {
+    return reg(lane, r);
+}
+
+int Lockstep::getPC(int lane) {
+    return pc[lane];
+}
+
+int Lockstep::getI(int lane) {
+    return regI[lane];
+}
+
+const byte *Lockstep::getMemory(int lane) {
+    return laneMemory(lane);
+}
+
+unsigned long Lockstep::getDraws(int lane) {
+    return draws[lane];
+}
+
+unsigned long Lockstep::getInstructions(int lane) {
+    return instructions[lane];
+}
+
+bool Lockstep::isWaitingForKey(int lane) {
+    return waitingForKey[lane] != 0;
+}
+
+int Lockstep::getLanes() {
+    return lanes;
+}
+
+unsigned long Lockstep::getFrames() {
+    return frames;
+}
+
+unsigned long Lockstep::getGroupSteps() {
+    return groupSteps;
+}
+
+unsigned long Lockstep::getLaneSteps() {
+    return laneSteps;
+}
@@ -0,0 +1,306 @@
+#ifndef LOCKSTEP_H_INCLUDED
+#define LOCKSTEP_H_INCLUDED
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "../memory.h"
+#include "../decoder.h"
+
+// Lanes processed together, lane count is rounded up to a multiple
+#define LOCKSTEP_CHUNK 16
+// Groups of lanes sharing a PC formed per step, remaining lanes run alone
+#define LOCKSTEP_MAX_GROUPS 4
+// Screen size of a lane
+#define LOCKSTEP_WIDTH 64
+#define LOCKSTEP_HEIGHT 32
+
+/**
+ * Runs many instances of one ROM in lockstep, in structure-of-arrays
+ * layout: each register, PC, I and timer of all lanes are stored next
+ * to each other, memories and framebuffers are contiguous.
+ *
+ * Every step executes one instruction on each lane. Lanes at the same
+ * PC whose code was not modified are run as a group, decoding once and
+ * executing register, timer and branch instructions on all lanes at once
+ * with AVX2 when the host supports it. Lanes that diverged are stepped
+ * alone. Results match a CPU run by Scheduler::runFrame() with the same
+ * seed and keys and the modern quirk profile, the only one emulated.
+ */
+class Lockstep {
+    private:
+        // Number of lanes and stride of the arrays
+        int lanes;
+        int stride;
+        int instructionsPerFrame;
+        // Use AVX2 kernels
+        bool avx2;
+
+        // Registers, V[reg * stride + lane]
+        std::vector<byte> regV;
+        std::vector<int32_t> regI;
+        std::vector<int32_t> pc;
+        std::vector<int32_t> regStack;
+        // Return addresses of each lane, STACK_SIZE entries apiece
+        std::vector<uint16_t> stack;
+        std::vector<byte> timerDelay;
+        std::vector<byte> timerSound;
+        // xorshift32 state of CXNN
+        std::vector<uint32_t> rngState;
+
+        // Memory of each lane, MEMORY_SIZE bytes apiece
+        std::vector<byte> mem;
+        // Framebuffer of each lane, one word per row
+        std::vector<uint64_t> screen;
+
+        // Initial memory shared by all lanes
+        byte image[MEMORY_SIZE];
+        // Set for bytes fetched by a group and checked in every lane
+        byte code[MEMORY_SIZE];
+        // Instructions of the image decoded by runStep(), by location
+        Instruction decoded[MEMORY_SIZE];
+        byte decodedValid[MEMORY_SIZE];
+        // Set for lanes whose fetched code may differ from the image
+        std::vector<byte> ownCode;
+
+        // Keys held and held in the previous frame
+        std::vector<uint16_t> keys;
+        std::vector<uint16_t> previousKeys;
+        // Key events of the last scan FX0A has not consumed
+        std::vector<uint16_t> pressEvents;
+        std::vector<uint16_t> releaseEvents;
+        // FX0A state
+        std::vector<byte> waitingForKey;
+        std::vector<byte> waitedKey;
+        // Lanes of the current group, lanes not yet run in this step and
+        // lanes not stopped by FX0A until the next frame, 0xFF if set
+        std::vector<byte> group;
+        std::vector<byte> pending;
+        std::vector<byte> active;
+        // Number of lanes set in active
+        int activeLanes;
+
+        // Counters
+        std::vector<unsigned long> draws;
+        std::vector<unsigned long> instructions;
+        unsigned long frames;
+        unsigned long groupSteps;
+        unsigned long laneSteps;
+
+        inline byte &reg(int lane, int r) {
+            return regV[r * stride + lane];
+        }
+
+        inline byte *laneMemory(int lane) {
+            return &mem[(size_t)lane * MEMORY_SIZE];
+        }
+
+        /**
+         * Reads memory of a lane, as Memory::getByte().
+         */
+        inline byte getByte(int lane, int location) {
+            return location >= 0 && location < MEMORY_SIZE ? laneMemory(lane)[location] : 0;
+        }
+
+        /**
+         * Writes memory of a lane, as Memory::setByte(). Writing to
+         * checked code moves the lane out of groups.
+         */
+        inline void setByte(int lane, int location, byte value) {
+            if (location >= 0 && location < MEMORY_SIZE) {
+                laneMemory(lane)[location] = value;
+                if (code[location]) {
+                    ownCode[lane] = 1;
+                }
+            }
+        }
+
+        /**
+         * Marks instruction at given location as code, moving lanes
+         * whose memory there differs from the image out of groups.
+         *
+         * @param location Location of the instruction
+         */
+        void checkCode(int location);
+
+        /**
+         * Executes an instruction on one lane, PC already advanced.
+         *
+         * @param lane Lane
+         * @param instruction Decoded instruction
+         */
+        void execute(int lane, const Instruction &instruction);
+
+        /**
+         * Fetches, decodes and executes next instruction of one lane.
+         *
+         * @param lane Lane
+         */
+        void step(int lane);
+
+        /**
+         * Executes an instruction on every lane of the group.
+         *
+         * @param instruction Decoded instruction
+         */
+        void runGroup(const Instruction &instruction);
+
+        /**
+         * Executes register, timer and branch instructions on the group with AVX2.
+         *
+         * @param instruction Decoded instruction
+         * @return <code>true</code> if executed, <code>false</code> if instruction is not supported
+         */
+        bool runGroupAvx2(const Instruction &instruction);
+
+        /**
+         * Selects pending lanes at given PC into the group.
+         *
+         * @param location PC of the group
+         * @return Number of lanes selected
+         */
+        int selectGroup(int location);
+
+        /**
+         * Selects pending lanes at given PC into the group with AVX2.
+         *
+         * @param location PC of the group
+         * @return Number of lanes selected
+         */
+        int selectGroupAvx2(int location);
+
+        /**
+         * Executes one instruction on each active lane.
+         */
+        void runStep();
+
+        /**
+         * FX0A, as CPU::waitForKey().
+         *
+         * @return <code>true</code> if key was released, <code>false</code> if lane stalls
+         */
+        bool waitForKey(int lane, int reg);
+
+        // Lanes own large arrays, copies are not allowed
+        Lockstep(const Lockstep &) = delete;
+        Lockstep &operator=(const Lockstep &) = delete;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param lanes Number of instances
+         * @param instructionsPerFrame Instructions executed per frame
+         * @param vector Use AVX2 when the host supports it
+         */
+        Lockstep(int lanes, int instructionsPerFrame, bool vector = true);
+
+        /**
+         * @return <code>true</code> if host supports AVX2 and it was built in
+         */
+        static bool hasAvx2();
+
+        /**
+         * Loads ROM into every lane and resets them.
+         *
+         * @param rom ROM contents
+         * @param length Size of the ROM
+         * @return <code>true</code> if ROM fits the memory, <code>false</code> otherwise
+         */
+        bool loadRom(const byte *rom, int length);
+
+        /**
+         * Seeds CXNN random generator of a lane, as CPU::seedRandom().
+         *
+         * @param lane Lane
+         * @param seed Seed
+         */
+        void seed(int lane, uint32_t seed);
+
+        /**
+         * Sets keys held by a lane from the next frame on.
+         *
+         * @param lane Lane
+         * @param mask Bit N set if key N is held
+         */
+        void setKeys(int lane, uint16_t mask);
+
+        /**
+         * Runs one frame on all lanes: scans keys, executes instructions
+         * and decrements timers.
+         */
+        void runFrame();
+
+        /**
+         * @param lane Lane
+         * @return FNV-1a hash of the lane's screen, as Machine::hashScreen()
+         */
+        uint32_t hashScreen(int lane);
+
+        /**
+         * @param lane Lane
+         * @param r Number of register
+         * @return Value stored in register
+         */
+        byte getRegister(int lane, int r);
+
+        /**
+         * @param lane Lane
+         * @return Location of the next instruction
+         */
+        int getPC(int lane);
+
+        /**
+         * @param lane Lane
+         * @return Value of the index register
+         */
+        int getI(int lane);
+
+        /**
+         * @param lane Lane
+         * @return MEMORY_SIZE bytes of the lane's memory
+         */
+        const byte *getMemory(int lane);
+
+        /**
+         * @param lane Lane
+         * @return Number of sprites drawn
+         */
+        unsigned long getDraws(int lane);
+
+        /**
+         * @param lane Lane
+         * @return Number of instructions executed, lanes stopped by
+         *         FX0A run none for the rest of the frame
+         */
+        unsigned long getInstructions(int lane);
+
+        /**
+         * @param lane Lane
+         * @return <code>true</code> if FX0A is waiting for a key, <code>false</code> otherwise
+         */
+        bool isWaitingForKey(int lane);
+
+        /**
+         * @return Number of lanes
+         */
+        int getLanes();
+
+        /**
+         * @return Number of frames run
+         */
+        unsigned long getFrames();
+
+        /**
+         * @return Instructions executed by lanes run in groups
+         */
+        unsigned long getGroupSteps();
+
+        /**
+         * @return Instructions executed by lanes stepped alone
+         */
+        unsigned long getLaneSteps();
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "machine.h"
+
+// Memory is cleared like the global array on the board, so that runs
+// are repeatable. Scripted keys do not bounce, keyboard is created
+// without debounce time.
+Machine::Machine(int instructionsPerFrame, uint32_t seed) :
+    mem(),
+    rng(seed),
+    keyboard(input, clock, 0),
+    screen(display, 2),
+    memory(storage, mem),
+    speaker(audio),
+    cpu(memory, screen, keyboard, speaker, clock, rng),
+    presenter(screen, clock),
+    scheduler(cpu, keyboard, presenter, timer, instructionsPerFrame) {
+    cpu.seedRandom(seed);
+}
+
+bool Machine::loadRom(const char *name, int profile) {
+    return memory.initialize() && memory.loadRom(name) && cpu.setQuirkProfile(profile);
+}
+
+bool Machine::loadRom(const byte *rom, int length, int profile) {
+    return memory.loadRom(rom, length) && cpu.setQuirkProfile(profile);
+}
+
+void Machine::runFrame() {
+    scheduler.runFrame();
+}
+
+uint32_t Machine::hashScreen() {
+    uint32_t hash = 2166136261u;
+    for (int y = 0; y < screen.getHeight(); y++) {
+        for (int x = 0; x < screen.getWidth(); x += 8) {
+            byte bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits = (bits << 1) | screen.isPixelOn(x + i, y);
+            }
+            hash = (hash ^ bits) * 16777619u;
+        }
+    }
+    return hash;
+}
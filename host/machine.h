@@ -0,0 +1,84 @@
+#ifndef MACHINE_H_INCLUDED
+#define MACHINE_H_INCLUDED
+
+#include "hal_host.h"
+#include "../cpu.h"
+#include "../keyboard.h"
+#include "../presenter.h"
+#include "../scheduler.h"
+
+/**
+ * Complete emulator instance with in-memory host backends,
+ * as wired up by the sketch on the board.
+ *
+ * Members are public so host programs can drive input and inspect
+ * the state. Instances are independent of each other.
+ */
+class Machine {
+    public:
+        byte mem[MEMORY_SIZE];
+
+        // Backends
+        HostDisplay display;
+        HostInput input;
+        HostStorage storage;
+        HostAudio audio;
+        HostClock clock;
+        HostFrameTimer timer;
+        HostRng rng;
+
+        // Emulator core
+        Keyboard keyboard;
+        Screen screen;
+        Memory memory;
+        Speaker speaker;
+        CPU cpu;
+        Presenter presenter;
+        Scheduler scheduler;
+
+        /**
+         * Default constructor.
+         *
+         * @param instructionsPerFrame Instructions executed per frame
+         * @param seed Value random generator is seeded with
+         */
+        Machine(int instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME, uint32_t seed = 1);
+
+        /**
+         * Loads ROM file and selects the quirks it is run with.
+         *
+         * @param name Path of the ROM
+         * @param profile One of QuirkProfile
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        bool loadRom(const char *name, int profile = PROFILE_MODERN);
+
+        /**
+         * Loads ROM from given bytes and selects the quirks it is run with.
+         *
+         * @param rom ROM contents
+         * @param length Size of the ROM
+         * @param profile One of QuirkProfile
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        bool loadRom(const byte *rom, int length, int profile = PROFILE_MODERN);
+
+        /**
+         * Runs one frame headless, see Scheduler::runFrame().
+         */
+        void runFrame();
+
+        /**
+         * Hashes the screen contents.
+         *
+         * @return FNV-1a hash of the visible pixels
+         */
+        uint32_t hashScreen();
+
+    private:
+        // Machine is wired to its own members, copies are not allowed
+        Machine(const Machine &) = delete;
+        Machine &operator=(const Machine &) = delete;
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "hal_host.h"
+#include "../cpu.h"
+#include "../presenter.h"
+#include "../scheduler.h"
+#include "../latency.h"
+#include "../snapshot.h"
+#include "rewind.h"
+#ifdef CHIPINO8_JIT
+#include "jit.h"
+#endif
+
+// Frames run when count is not given
+#define DEFAULT_FRAMES 100000
+// Longest input log replayed
+#define MAX_INPUT_LOG_SIZE (1024 * 1024)
+
+/**
+ * Runs a ROM headless, without waiting for frames to end,
+ * and reports interpreter throughput.
+ *
+ * Usage: chipino8_host [-j] [-q quirks] [-p profile] [-r snapshot] [-s snapshot] [-w frames] [-i log] <rom> [frames] [instructions per frame]
+ *
+ * -j runs the ROM with the basic-block translator.
+ * -q emulates the quirks of an interpreter: modern (default), vip,
+ *    chip48 or schip.
+ * -p writes execution profile to given file, in builds with CPU_PROFILE.
+ * -r restores machine state from given snapshot before running.
+ * -s saves machine state to given snapshot after running.
+ * -w captures rewind state every frame and goes back given number of
+ *    frames after running, before the snapshot is saved.
+ * -i replays given input log, recorded from reset on the board. Quirk
+ *    profile and seed are taken from the log, speed and number of frames
+ *    too unless given. A -q other than the logged profile is refused.
+ */
+int main(int argc, char **argv) {
+    bool useJit = false;
+    int quirkProfile = PROFILE_MODERN;
+    bool quirksGiven = false;
+    const char *profileName = NULL;
+    const char *restoreName = NULL;
+    const char *saveName = NULL;
+    int rewindFrames = -1;
+    const char *inputLogName = NULL;
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-j") == 0) {
+            useJit = true;
+        } else if (strcmp(argv[1], "-q") == 0 && argc > 2) {
+            quirkProfile = CPU::findQuirkProfile(argv[2]);
+            if (quirkProfile < 0) {
+                fprintf(stderr, "unknown quirk profile %s\n", argv[2]);
+                return 2;
+            }
+            quirksGiven = true;
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "-p") == 0 && argc > 2) {
+            profileName = argv[2];
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "-r") == 0 && argc > 2) {
+            restoreName = argv[2];
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "-s") == 0 && argc > 2) {
+            saveName = argv[2];
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "-w") == 0 && argc > 2) {
+            rewindFrames = atoi(argv[2]);
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "-i") == 0 && argc > 2) {
+            inputLogName = argv[2];
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+        argc--;
+        argv++;
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "usage: chipino8_host [-j] [-q quirks] [-p profile] [-r snapshot] [-s snapshot] [-w frames] [-i log] <rom> [frames] [instructions per frame]\n");
+        return 2;
+    }
+    long frames = argc > 2 ? atol(argv[2]) : DEFAULT_FRAMES;
+    int instructionsPerFrame = argc > 3 ? atoi(argv[3]) : DEFAULT_INSTRUCTIONS_PER_FRAME;
+
+    static byte mem[MEMORY_SIZE];
+    HostDisplay display;
+    HostInput input;
+    HostStorage storage;
+    HostAudio audio;
+    HostClock clock;
+    HostFrameTimer timer;
+    HostRng rng;
+
+    // Scripted keys do not bounce
+    Keyboard keyboard(input, clock, 0);
+    Screen screen(display, 2);
+    Memory memory(storage, mem);
+    Speaker speaker(audio);
+
+    if (!memory.initialize() || !memory.loadRom(argv[1])) {
+        fprintf(stderr, "error loading ROM %s\n", argv[1]);
+        return 1;
+    }
+
+    InputLatency latency(clock);
+    HostLog log(stdout);
+    keyboard.setLatency(&latency);
+    screen.setLatency(&latency);
+
+    CPU cpu(memory, screen, keyboard, speaker, clock, rng);
+    cpu.setQuirkProfile(quirkProfile);
+    Presenter presenter(screen, clock);
+    Scheduler scheduler(cpu, keyboard, presenter, timer, instructionsPerFrame);
+
+    static byte inputLogBuffer[MAX_INPUT_LOG_SIZE];
+    InputLog inputLog(inputLogBuffer, sizeof(inputLogBuffer));
+    if (inputLogName) {
+        if (restoreName) {
+            fprintf(stderr, "input logs are replayed from reset, not from a snapshot\n");
+            return 2;
+        }
+        if (!inputLog.load(storage, inputLogName)) {
+            fprintf(stderr, "error loading input log %s\n", inputLogName);
+            return 1;
+        }
+        if (inputLog.getRomChecksum() != Snapshot::checksum(mem, MEMORY_SIZE)) {
+            fprintf(stderr, "input log %s was recorded with another ROM\n", inputLogName);
+            return 1;
+        }
+        if (quirksGiven && inputLog.getQuirkProfile() != quirkProfile) {
+            fprintf(stderr, "input log %s was recorded with %s quirks\n", inputLogName,
+                CPU::getQuirkProfileName(inputLog.getQuirkProfile()));
+            return 1;
+        }
+        cpu.setQuirkProfile(inputLog.getQuirkProfile());
+        cpu.seedRandom(inputLog.getSeed());
+        if (argc <= 2) {
+            frames = inputLog.getFrames();
+        }
+        if (argc <= 3) {
+            scheduler.setInstructionsPerFrame(inputLog.getInstructionsPerFrame());
+        }
+        scheduler.setInputLog(&inputLog);
+    }
+
+#ifdef CHIPINO8_JIT
+    Jit jit(cpu, memory);
+    if (useJit) {
+        if (!jit.isAvailable()) {
+            fprintf(stderr, "executable memory not available\n");
+            return 1;
+        }
+        scheduler.setEngine(jit);
+    }
+#else
+    if (useJit) {
+        fprintf(stderr, "translator not built for this host\n");
+        return 1;
+    }
+#endif
+
+#if CPU_PROFILE
+    Profiler profiler;
+    if (profileName) {
+        cpu.setProfiler(&profiler);
+        presenter.setProfiler(&profiler);
+    }
+#else
+    if (profileName) {
+        fprintf(stderr, "profiler not built, configure with -DCHIPINO8_PROFILE=ON\n");
+        return 1;
+    }
+#endif
+
+    static byte snapshot[SNAPSHOT_MAX_SIZE];
+    if (restoreName && !Snapshot::restore(cpu, memory, screen, storage, restoreName, snapshot)) {
+        fprintf(stderr, "error restoring snapshot %s\n", restoreName);
+        return 1;
+    }
+
+    Rewind *rewind = NULL;
+    double captureSeconds = 0;
+    if (rewindFrames >= 0) {
+        rewind = new Rewind(cpu, memory, screen, mem);
+        rewind->capture();
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < frames; i++) {
+        scheduler.runFrame();
+        if (rewind) {
+            std::chrono::steady_clock::time_point captureStart = std::chrono::steady_clock::now();
+            rewind->capture();
+            captureSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - captureStart).count();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - captureSeconds;
+
+    printf("frames: %lu\n", scheduler.getFrames());
+    printf("instructions: %lu\n", scheduler.getInstructions());
+    printf("seconds: %.6f\n", seconds);
+    printf("instructions/s: %.0f\n", seconds > 0 ? scheduler.getInstructions() / seconds : 0.0);
+    printf("idle frames: %lu\n", scheduler.getIdleFrames());
+    printf("idle instructions skipped: %lu\n", cpu.getIdleInstructions());
+    printf("frames presented: %lu\n", presenter.getFramesPresented());
+    printf("frames skipped: %lu\n", presenter.getFramesSkipped());
+    printf("draws coalesced: %lu\n", presenter.getDrawsCoalesced());
+    for (int fusion = OP_COUNT; fusion < FUSION_END; fusion++) {
+        printf("%s: %u\n", DecodeCache::getFusionName(fusion), cpu.getFusionHits(fusion));
+    }
+    latency.report(log);
+
+    if (rewind) {
+        printf("rewind frames kept: %d\n", rewind->getFrames());
+        printf("rewind keyframes: %lu, deltas: %lu\n", rewind->getKeyframes(), rewind->getDeltas());
+        printf("rewind bytes stored: %ld, memory used: %ld\n", rewind->getBytesStored(), rewind->getMemoryUsed());
+        printf("rewind capture: %.2f us/frame, %.1f%% of emulation\n",
+            frames > 0 ? captureSeconds * 1e6 / frames : 0.0, seconds > 0 ? captureSeconds * 100 / seconds : 0.0);
+        std::chrono::steady_clock::time_point seekStart = std::chrono::steady_clock::now();
+        if (!rewind->seek(rewindFrames)) {
+            fprintf(stderr, "rewind of %d frames not kept\n", rewindFrames);
+            return 1;
+        }
+        double seekTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - seekStart).count();
+        printf("rewind seek: %d frames back in %.1f us\n", rewindFrames, seekTime * 1e6);
+    }
+
+    if (saveName) {
+        std::chrono::steady_clock::time_point saveStart = std::chrono::steady_clock::now();
+        int length = Snapshot::save(cpu, memory, screen, snapshot, sizeof(snapshot));
+        double saveTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count();
+        if (length < 0 || storage.write(saveName, snapshot, length) != length) {
+            fprintf(stderr, "error saving snapshot %s\n", saveName);
+            return 1;
+        }
+        printf("snapshot: %d bytes, encoded in %.1f us\n", length, saveTime * 1e6);
+    }
+
+#if CPU_PROFILE
+    if (profileName) {
+        FILE *file = fopen(profileName, "w");
+        if (!file) {
+            fprintf(stderr, "error writing profile %s\n", profileName);
+            return 1;
+        }
+        HostLog profileLog(file);
+        profiler.report(profileLog);
+        fclose(file);
+    }
+#endif
+    delete rewind;
+#ifdef CHIPINO8_JIT
+    if (useJit) {
+        printf("blocks compiled: %lu\n", jit.getBlocksCompiled());
+        printf("block runs: %lu\n", jit.getBlockRuns());
+        printf("interpreted: %lu\n", jit.getInterpreted());
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,272 @@
+#include "rewind.h"
+
+#include <string.h>
+
+// Number of memory blocks, one dirty bit each
+#define REWIND_BLOCKS (MEMORY_SIZE / REWIND_BLOCK_SIZE)
+
+/**
+ * Writes a 64 bit mask.
+ */
+static void putMask(StateWriter &out, uint64_t mask) {
+    for (int i = 0; i < 4; i++) {
+        out.putWord((uint16_t)(mask >> (i * 16)));
+    }
+}
+
+/**
+ * Reads a 64 bit mask written by putMask().
+ */
+static uint64_t getMask(StateReader &in) {
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        mask |= (uint64_t)in.getWord() << (i * 16);
+    }
+    return mask;
+}
+
+Rewind::Rewind(CPU &cpu, Memory &memory, Screen &screen, const byte *ram, int bufferSize, int maxFrames,
+    int keyframeInterval) : cpu(cpu), memory(memory), screen(screen), ram(ram), keyframeInterval(keyframeInterval),
+    head(0), first(0), count(0), stored(0), keyWidth(0), keyHeight(0), keyFrame(0), hasKeyframe(false),
+    dirtyBlocks(0), dirtyRows(0), staleBlocks(~0ULL), frame(0), keyframes(0), deltas(0) {
+    ring.resize(bufferSize > REWIND_MIN_BUFFER_SIZE ? bufferSize : REWIND_MIN_BUFFER_SIZE);
+    records.resize(maxFrames > 1 ? maxFrames : 1);
+    // Fits a keyframe and a delta of every block and row
+    scratch.resize(SNAPSHOT_MAX_SIZE + SNAPSHOT_PACKED_SIZE(sizeof(changes)));
+    if (this->keyframeInterval < 1) {
+        this->keyframeInterval = 1;
+    }
+    memory.addObserver(this);
+}
+
+void Rewind::onMemoryWrite(int location, int length) {
+    int last = (location + length - 1) / REWIND_BLOCK_SIZE;
+    for (int block = location / REWIND_BLOCK_SIZE; block <= last && block < REWIND_BLOCKS; block++) {
+        dirtyBlocks |= 1ULL << block;
+    }
+}
+
+Rewind::Record &Rewind::record(int index) {
+    index += first;
+    return records[index < (int)records.size() ? index : index - (int)records.size()];
+}
+
+void Rewind::dropOldest() {
+    stored -= record(0).length;
+    first = first + 1 < (int)records.size() ? first + 1 : 0;
+    count--;
+}
+
+bool Rewind::store(int length, bool keyframe) {
+    if (count == (int)records.size()) {
+        dropOldest();
+    }
+    if (head + length > (int)ring.size()) {
+        // Records past the head are the oldest, the ring wraps before them
+        while (count > 0 && record(0).offset >= head) {
+            dropOldest();
+        }
+        head = 0;
+    }
+    while (count > 0 && record(0).offset >= head && record(0).offset < head + length) {
+        dropOldest();
+    }
+    // Deltas are useless without their keyframe
+    while (count > 0 && !record(0).keyframe) {
+        dropOldest();
+    }
+    if (!keyframe && (count == 0 || record(0).frame > keyFrame)) {
+        return false;
+    }
+
+    memcpy(&ring[head], scratch.data(), length);
+    Record &added = record(count++);
+    added.frame = frame;
+    added.offset = head;
+    added.length = length;
+    added.keyframe = keyframe;
+    head += length;
+    stored += length;
+    return true;
+}
+
+int Rewind::encodeKeyframe() {
+    keyWidth = screen.getWidth();
+    keyHeight = screen.getHeight();
+    for (uint64_t blocks = dirtyBlocks | staleBlocks; blocks; blocks &= blocks - 1) {
+        int block = __builtin_ctzll(blocks);
+        int location = block * REWIND_BLOCK_SIZE;
+        memcpy(keyRam + location, ram + location, REWIND_BLOCK_SIZE);
+        StateWriter packed(packedBlocks[block], sizeof(packedBlocks[block]));
+        packed.putPacked(keyRam + location, REWIND_BLOCK_SIZE);
+        packedLengths[block] = packed.getLength();
+    }
+    staleBlocks = 0;
+    for (int y = 0; y < keyHeight; y++) {
+        screen.getRow(y, keyRows[y]);
+    }
+    keyFrame = frame;
+    hasKeyframe = true;
+    dirtyBlocks = 0;
+    dirtyRows = 0;
+
+    StateWriter out(scratch.data(), (int)scratch.size());
+    out.putByte(keyWidth);
+    out.putByte(keyHeight);
+    cpu.saveState(out);
+    for (int block = 0; block < REWIND_BLOCKS; block++) {
+        out.putBytes(packedBlocks[block], packedLengths[block]);
+    }
+    for (int y = 0; y < keyHeight; y++) {
+        out.putPacked(keyRows[y], keyWidth / 8);
+    }
+    return out.getLength();
+}
+
+int Rewind::encodeDelta() {
+    int length = 0;
+    for (uint64_t blocks = dirtyBlocks; blocks; blocks &= blocks - 1) {
+        int location = __builtin_ctzll(blocks) * REWIND_BLOCK_SIZE;
+        for (int i = location; i < location + REWIND_BLOCK_SIZE; i++) {
+            changes[length++] = ram[i] ^ keyRam[i];
+        }
+    }
+    byte row[MAX_WIDTH / 8];
+    for (uint64_t rows = dirtyRows; rows; rows &= rows - 1) {
+        int y = __builtin_ctzll(rows);
+        screen.getRow(y, row);
+        for (int i = 0; i < keyWidth / 8; i++) {
+            changes[length++] = row[i] ^ keyRows[y][i];
+        }
+    }
+
+    StateWriter out(scratch.data(), (int)scratch.size());
+    cpu.saveState(out);
+    putMask(out, dirtyBlocks);
+    putMask(out, dirtyRows);
+    out.putPacked(changes, length);
+    return out.getLength();
+}
+
+void Rewind::capture() {
+    uint64_t rows = screen.takeChangedRows();
+    if (keyHeight < 64) {
+        rows &= (1ULL << keyHeight) - 1;
+    }
+    dirtyRows |= rows;
+    bool keyframe = !hasKeyframe || frame - keyFrame >= (unsigned long)keyframeInterval
+        || screen.getWidth() != keyWidth || screen.getHeight() != keyHeight;
+    if (keyframe || !store(encodeDelta(), false)) {
+        store(encodeKeyframe(), true);
+        keyframes++;
+    } else {
+        deltas++;
+    }
+    frame++;
+}
+
+bool Rewind::seek(int frames) {
+    if (frames < 0 || frames >= count) {
+        return false;
+    }
+    int target = count - 1 - frames;
+    int base = target;
+    while (!record(base).keyframe) {
+        base--;
+    }
+
+    // Keyframe becomes the base of deltas captured from here on
+    const Record &key = record(base);
+    StateReader in(&ring[key.offset], key.length);
+    keyWidth = in.getByte();
+    keyHeight = in.getByte();
+    byte cpuState[SNAPSHOT_CPU_SIZE];
+    in.getBytes(cpuState, SNAPSHOT_CPU_SIZE);
+    for (int location = 0; location < MEMORY_SIZE; location += REWIND_BLOCK_SIZE) {
+        in.getPacked(keyRam + location, REWIND_BLOCK_SIZE);
+    }
+    for (int y = 0; y < keyHeight; y++) {
+        in.getPacked(keyRows[y], keyWidth / 8);
+    }
+    keyFrame = key.frame;
+    hasKeyframe = true;
+    staleBlocks = ~0ULL;
+
+    byte current[MEMORY_SIZE];
+    byte currentRows[MAX_HEIGHT][MAX_WIDTH / 8];
+    memcpy(current, keyRam, MEMORY_SIZE);
+    memcpy(currentRows, keyRows, sizeof(keyRows));
+    uint64_t blocks = 0;
+    uint64_t rows = 0;
+    const Record &delta = record(target);
+    if (!delta.keyframe) {
+        StateReader changed(&ring[delta.offset], delta.length);
+        changed.getBytes(cpuState, SNAPSHOT_CPU_SIZE);
+        blocks = getMask(changed);
+        rows = getMask(changed);
+        int length = __builtin_popcountll(blocks) * REWIND_BLOCK_SIZE + __builtin_popcountll(rows) * (keyWidth / 8);
+        changed.getPacked(changes, length);
+        length = 0;
+        for (uint64_t b = blocks; b; b &= b - 1) {
+            int location = __builtin_ctzll(b) * REWIND_BLOCK_SIZE;
+            for (int i = location; i < location + REWIND_BLOCK_SIZE; i++) {
+                current[i] ^= changes[length++];
+            }
+        }
+        for (uint64_t r = rows; r; r &= r - 1) {
+            int y = __builtin_ctzll(r);
+            for (int i = 0; i < keyWidth / 8; i++) {
+                currentRows[y][i] ^= changes[length++];
+            }
+        }
+    }
+
+    // State is loaded through the snapshot readers, which notify the
+    // decode cache and redraw the panel
+    StateWriter out(scratch.data(), (int)scratch.size());
+    out.putBytes(cpuState, SNAPSHOT_CPU_SIZE);
+    out.putPacked(current, MEMORY_SIZE);
+    for (int y = 0; y < keyHeight; y++) {
+        out.putPacked(currentRows[y], keyWidth / 8);
+    }
+    if (screen.getWidth() != keyWidth) {
+        screen.setWidth(keyWidth);
+    }
+    if (screen.getHeight() != keyHeight) {
+        screen.setHeight(keyHeight);
+    }
+    StateReader state(scratch.data(), out.getLength());
+    cpu.loadState(state);
+    memory.loadState(state);
+    screen.loadState(state);
+    screen.takeChangedRows();
+    dirtyBlocks = blocks;
+    dirtyRows = rows;
+
+    head = delta.offset + delta.length;
+    frame = delta.frame + 1;
+    while (count > target + 1) {
+        stored -= record(--count).length;
+    }
+    return true;
+}
+
+int Rewind::getFrames() {
+    return count;
+}
+
+long Rewind::getBytesStored() {
+    return stored;
+}
+
+long Rewind::getMemoryUsed() {
+    return (long)(sizeof(Rewind) + ring.size() + records.size() * sizeof(Record) + scratch.size());
+}
+
+unsigned long Rewind::getKeyframes() {
+    return keyframes;
+}
+
+unsigned long Rewind::getDeltas() {
+    return deltas;
+}
@@ -0,0 +1,191 @@
+#ifndef REWIND_H_INCLUDED
+#define REWIND_H_INCLUDED
+
+#include <vector>
+
+#include "../cpu.h"
+#include "../scheduler.h"
+#include "../snapshot.h"
+
+// Bytes of the record ring when not given
+#define REWIND_BUFFER_SIZE (2 * 1024 * 1024)
+// Most frames kept when not given, five minutes
+#define REWIND_MAX_FRAMES (5 * 60 * FRAME_RATE)
+// Frames between two keyframes when not given
+#define REWIND_KEYFRAME_INTERVAL 60
+// Bytes of memory tracked by one dirty bit
+#define REWIND_BLOCK_SIZE 64
+// Smallest ring accepted, fits a few keyframes
+#define REWIND_MIN_BUFFER_SIZE (4 * SNAPSHOT_MAX_SIZE)
+
+/**
+ * Continuous rewind for debugging and QA on the host.
+ *
+ * capture() is called after every frame and appends a record of the
+ * machine state to a fixed-size ring. Every few frames the record is a
+ * keyframe: CPU section, run-length encoded RAM and framebuffer, as in
+ * a Snapshot, with RAM encoded in blocks so that blocks not written
+ * since the previous keyframe are not encoded again. Other records hold the CPU section and the RAM blocks and
+ * screen rows written since the last keyframe, XORed with the keyframe
+ * and run-length encoded. Writes are tracked by observing Memory and by
+ * Screen::takeChangedRows(), so unchanged RAM is never scanned.
+ *
+ * Any kept frame is restored from its keyframe and one delta. When the
+ * ring is full the oldest keyframe and its deltas are dropped.
+ */
+class Rewind : public MemoryObserver {
+    private:
+        /**
+         * Location of a record in the ring.
+         */
+        struct Record {
+            // Number of the frame captured
+            unsigned long frame;
+            int offset;
+            int length;
+            bool keyframe;
+        };
+
+        CPU &cpu;
+        Memory &memory;
+        Screen &screen;
+        // Memory contents, as given to Memory
+        const byte *ram;
+        int keyframeInterval;
+
+        // Records, stored one after another and wrapping around
+        std::vector<byte> ring;
+        // Offset in the ring the next record is written to
+        int head;
+        // Circular index of the records, oldest first
+        std::vector<Record> records;
+        int first;
+        int count;
+        // Bytes of the ring used by kept records
+        long stored;
+
+        // State at the last keyframe
+        byte keyRam[MEMORY_SIZE];
+        byte keyRows[MAX_HEIGHT][MAX_WIDTH / 8];
+        int keyWidth;
+        int keyHeight;
+        unsigned long keyFrame;
+        bool hasKeyframe;
+        // Memory blocks and screen rows written since the last keyframe
+        uint64_t dirtyBlocks;
+        uint64_t dirtyRows;
+        // Run-length encoded blocks of keyRam, reused by the next
+        // keyframe for blocks not written since, unless set in staleBlocks
+        byte packedBlocks[MEMORY_SIZE / REWIND_BLOCK_SIZE][SNAPSHOT_PACKED_SIZE(REWIND_BLOCK_SIZE)];
+        byte packedLengths[MEMORY_SIZE / REWIND_BLOCK_SIZE];
+        uint64_t staleBlocks;
+
+        // Record being encoded, and XOR of the changed bytes
+        std::vector<byte> scratch;
+        byte changes[MEMORY_SIZE + MAX_HEIGHT * MAX_WIDTH / 8];
+
+        // Number of the next frame captured
+        unsigned long frame;
+        // Counters
+        unsigned long keyframes;
+        unsigned long deltas;
+
+        // Rewind is observed by memory, copies are not allowed
+        Rewind(const Rewind &) = delete;
+        Rewind &operator=(const Rewind &) = delete;
+
+        /**
+         * @param index Index of a record, 0 for the oldest
+         * @return The record
+         */
+        Record &record(int index);
+
+        /**
+         * Drops the oldest record.
+         */
+        void dropOldest();
+
+        /**
+         * Copies an encoded record to the ring, dropping old records to
+         * make room.
+         *
+         * @param length Length of the record in scratch
+         * @param keyframe <code>true</code> if the record is a keyframe
+         * @return <code>true</code> if stored, <code>false</code> if the
+         *         keyframe of a delta was dropped and nothing was stored
+         */
+        bool store(int length, bool keyframe);
+
+        /**
+         * Encodes a keyframe to scratch and makes it the base of deltas.
+         *
+         * @return Length of the record
+         */
+        int encodeKeyframe();
+
+        /**
+         * Encodes changes since the last keyframe to scratch.
+         *
+         * @return Length of the record
+         */
+        int encodeDelta();
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param cpu CPU to be captured
+         * @param memory Memory of the CPU, observed for writes
+         * @param screen Screen of the CPU
+         * @param ram Byte array the memory was created with
+         * @param bufferSize Bytes of the record ring, at least REWIND_MIN_BUFFER_SIZE
+         * @param maxFrames Most frames kept
+         * @param keyframeInterval Frames between two keyframes
+         */
+        Rewind(CPU &cpu, Memory &memory, Screen &screen, const byte *ram, int bufferSize = REWIND_BUFFER_SIZE,
+            int maxFrames = REWIND_MAX_FRAMES, int keyframeInterval = REWIND_KEYFRAME_INTERVAL);
+
+        void onMemoryWrite(int location, int length);
+
+        /**
+         * Records the current state, called once per frame.
+         */
+        void capture();
+
+        /**
+         * Restores the state captured given number of frames before the
+         * last one. Frames captured after it are dropped, capturing goes
+         * on from the restored frame.
+         *
+         * @param frames Number of frames to go back, 0 restores the last capture
+         * @return <code>true</code> if restored, <code>false</code> if the frame is not kept
+         */
+        bool seek(int frames);
+
+        /**
+         * @return Number of frames that can be restored
+         */
+        int getFrames();
+
+        /**
+         * @return Bytes of the ring used by kept records
+         */
+        long getBytesStored();
+
+        /**
+         * @return Bytes allocated by the rewind, fixed at construction
+         */
+        long getMemoryUsed();
+
+        /**
+         * @return Number of keyframes captured
+         */
+        unsigned long getKeyframes();
+
+        /**
+         * @return Number of deltas captured
+         */
+        unsigned long getDeltas();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "roms.h"
+
+#include <string.h>
+
+// Register arithmetic loop
+static const byte ALU_LOOP[] = {
+    0x60, 0x00, 0x61, 0x00, 0x70, 0x01, 0x80, 0x14, 0x81, 0x02, 0xA3, 0x00, 0xF0, 0x1E, 0x82, 0x06,
+    0x40, 0x00, 0x12, 0x00, 0x30, 0x00, 0x12, 0x04, 0x12, 0x00
+};
+
+// Draws 8x15 sprites walking over the whole screen
+static const byte SPRITES[] = {
+    0x60, 0x00, 0x61, 0x00, 0xA0, 0x00, 0xD0, 0x1F, 0x70, 0x07, 0x71, 0x03, 0x12, 0x04
+};
+
+// Busy-waits on the delay timer between two draws
+static const byte DELAY_WAIT[] = {
+    0x60, 0x05, 0xF0, 0x15, 0xF1, 0x07, 0x31, 0x00, 0x12, 0x04, 0xA0, 0x00, 0xD0, 0x15, 0x72, 0x01,
+    0x32, 0x00, 0x12, 0x00, 0x12, 0x00
+};
+
+// Polls key 5 and draws while it is held
+static const byte KEY_POLL[] = {
+    0x60, 0x05, 0xE0, 0x9E, 0x12, 0x02, 0xA0, 0x00, 0xD0, 0x15, 0x12, 0x02
+};
+
+// Waits for a key with FX0A and draws its digit
+static const byte KEY_WAIT[] = {
+    0x61, 0x01, 0xF1, 0x0A, 0xF1, 0x29, 0xD1, 0x15, 0x12, 0x02
+};
+
+// Random mazes of small sprites
+static const byte ALONSY[] = {
+    0xa2, 0x1e, 0xc2, 0x01, 0x32, 0x01, 0xa2, 0x1a, 0xd0, 0x14, 0x70, 0x04, 0x30, 0x40, 0x12, 0x00,
+    0x60, 0x00, 0x71, 0x04, 0x31, 0x20, 0x12, 0x00, 0x12, 0x18, 0x80, 0x40, 0x20, 0x10, 0x20, 0x40,
+    0x80, 0x10
+};
+
+const BuiltinRom builtinRoms[] = {
+    {"alu_loop", ALU_LOOP, sizeof(ALU_LOOP)},
+    {"sprites", SPRITES, sizeof(SPRITES)},
+    {"delay_wait", DELAY_WAIT, sizeof(DELAY_WAIT)},
+    {"key_poll", KEY_POLL, sizeof(KEY_POLL)},
+    {"key_wait", KEY_WAIT, sizeof(KEY_WAIT)},
+    {"alonsy", ALONSY, sizeof(ALONSY)}
+};
+
+const int BUILTIN_ROM_COUNT = sizeof(builtinRoms) / sizeof(builtinRoms[0]);
+
+const BuiltinRom *findBuiltinRom(const char *name) {
+    for (int i = 0; i < BUILTIN_ROM_COUNT; i++) {
+        if (strcmp(builtinRoms[i].name, name) == 0) {
+            return &builtinRoms[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef ROMS_H_INCLUDED
+#define ROMS_H_INCLUDED
+
+#include "../hal.h"
+
+/**
+ * ROM built into the host tools.
+ */
+struct BuiltinRom {
+    const char *name;
+    const byte *data;
+    int length;
+};
+
+// ROMs built into the host tools
+extern const BuiltinRom builtinRoms[];
+// Number of entries in builtinRoms
+extern const int BUILTIN_ROM_COUNT;
+
+/**
+ * Finds a built in ROM by name.
+ *
+ * @param name Name of the ROM
+ * @return The ROM, NULL if there is no such ROM
+ */
+const BuiltinRom *findBuiltinRom(const char *name);
+
+#endif
@@ -0,0 +1,120 @@
+#include "work_pool.h"
+
+#include <thread>
+
+/**
+ * @param requested Number of threads asked for, 0 for one per hardware thread
+ * @return Number of threads to be used
+ */
+static int workersFor(int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    int available = std::thread::hardware_concurrency();
+    return available > 0 ? available : 1;
+}
+
+WorkPool::WorkPool(int numWorkers) :
+    numWorkers(workersFor(numWorkers)),
+    ranges(this->numWorkers),
+    jobsDone(this->numWorkers),
+    steals(this->numWorkers) {}
+
+int WorkPool::take(int worker) {
+    Range &range = ranges[worker];
+    std::lock_guard<std::mutex> guard(range.lock);
+    if (range.begin >= range.end) {
+        return -1;
+    }
+    return range.begin++;
+}
+
+bool WorkPool::steal(int worker) {
+    while (true) {
+        // Largest range may shrink before it is locked again below
+        int victim = -1;
+        int largest = 0;
+        for (int i = 0; i < numWorkers; i++) {
+            if (i == worker) {
+                continue;
+            }
+            int left;
+            {
+                std::lock_guard<std::mutex> guard(ranges[i].lock);
+                left = ranges[i].end - ranges[i].begin;
+            }
+            if (left > largest) {
+                victim = i;
+                largest = left;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        int begin;
+        int end;
+        {
+            Range &range = ranges[victim];
+            std::lock_guard<std::mutex> guard(range.lock);
+            int left = range.end - range.begin;
+            if (left <= 0) {
+                continue;
+            }
+            end = range.end;
+            begin = range.end - (left + 1) / 2;
+            range.end = begin;
+        }
+        Range &own = ranges[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.begin = begin;
+        own.end = end;
+        steals[worker]++;
+        return true;
+    }
+}
+
+void WorkPool::work(int worker, const std::function<void(int, int)> &job) {
+    while (true) {
+        int index = take(worker);
+        if (index < 0) {
+            if (!steal(worker)) {
+                return;
+            }
+            continue;
+        }
+        job(index, worker);
+        jobsDone[worker]++;
+    }
+}
+
+void WorkPool::run(int count, const std::function<void(int, int)> &job) {
+    for (int i = 0; i < numWorkers; i++) {
+        ranges[i].begin = (int)((long long)count * i / numWorkers);
+        ranges[i].end = (int)((long long)count * (i + 1) / numWorkers);
+        jobsDone[i] = 0;
+        steals[i] = 0;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numWorkers; i++) {
+        threads.push_back(std::thread(&WorkPool::work, this, i, std::cref(job)));
+    }
+    // Calling thread is worker 0
+    work(0, job);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+int WorkPool::getNumWorkers() {
+    return numWorkers;
+}
+
+unsigned long WorkPool::getJobsDone(int worker) {
+    return jobsDone[worker];
+}
+
+unsigned long WorkPool::getSteals(int worker) {
+    return steals[worker];
+}
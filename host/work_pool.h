@@ -0,0 +1,92 @@
+#ifndef WORK_POOL_H_INCLUDED
+#define WORK_POOL_H_INCLUDED
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * Work-stealing thread pool running a numbered batch of jobs.
+ *
+ * Jobs are split into one contiguous range per worker. A worker takes
+ * jobs from the front of its own range; once it runs dry it steals the
+ * back half of the largest range left with another worker. Jobs must be
+ * independent of each other.
+ */
+class WorkPool {
+    private:
+        /**
+         * Jobs left with a worker, [begin, end).
+         */
+        struct Range {
+            std::mutex lock;
+            int begin;
+            int end;
+        };
+
+        int numWorkers;
+        std::vector<Range> ranges;
+
+        // Per worker counters
+        std::vector<unsigned long> jobsDone;
+        std::vector<unsigned long> steals;
+
+        /**
+         * Takes next job of a worker.
+         *
+         * @param worker Index of the worker
+         * @return Job index, -1 if worker has nothing left
+         */
+        int take(int worker);
+
+        /**
+         * Moves back half of the largest other range to the worker.
+         *
+         * @param worker Index of the stealing worker
+         * @return <code>true</code> if jobs were stolen, <code>false</code> if all ranges are empty
+         */
+        bool steal(int worker);
+
+        /**
+         * Runs jobs until none are left.
+         *
+         * @param worker Index of the worker
+         * @param job Function running one job
+         */
+        void work(int worker, const std::function<void(int, int)> &job);
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param numWorkers Number of threads, 0 for one per hardware thread
+         */
+        WorkPool(int numWorkers = 0);
+
+        /**
+         * Runs jobs 0 to count - 1 and returns when all are done.
+         *
+         * @param count Number of jobs
+         * @param job Function called with the job index and the worker index
+         */
+        void run(int count, const std::function<void(int, int)> &job);
+
+        /**
+         * @return Number of threads
+         */
+        int getNumWorkers();
+
+        /**
+         * @param worker Index of the worker
+         * @return Jobs run by the worker in the last run()
+         */
+        unsigned long getJobsDone(int worker);
+
+        /**
+         * @param worker Index of the worker
+         * @return Successful steals of the worker in the last run()
+         */
+        unsigned long getSteals(int worker);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "input_log.h"
+
+#include "quirks.h"
+#include "snapshot.h"
+
+// Identifies input log files
+static const byte INPUT_LOG_MAGIC[] = {'C', '8', 'I', 'L'};
+
+InputLog::InputLog(byte *buffer, int size) : buffer(buffer), size(size), length(0), recording(false), replaying(false),
+    full(false), quirkProfile(PROFILE_MODERN), seed(1), instructionsPerFrame(0), romChecksum(0), frame(0), frames(0), entryFrame(0), keys(0), position(0) {}
+
+void InputLog::putHeader() {
+    StateWriter out(buffer, size);
+    out.putBytes(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC));
+    out.putByte(INPUT_LOG_VERSION);
+    out.putByte(quirkProfile);
+    out.putWord(seed & 0xFFFF);
+    out.putWord(seed >> 16);
+    out.putWord(instructionsPerFrame);
+    out.putWord(romChecksum);
+    out.putWord(frames & 0xFFFF);
+    out.putWord(frames >> 16);
+}
+
+void InputLog::putEntry(uint16_t gap, uint16_t mask) {
+    // Room for the checksum is kept, so that a full log can still be saved
+    if (length + INPUT_LOG_ENTRY_SIZE + INPUT_LOG_CHECKSUM_SIZE > size) {
+        full = true;
+        return;
+    }
+    buffer[length++] = gap & 0xFF;
+    buffer[length++] = gap >> 8;
+    buffer[length++] = mask & 0xFF;
+    buffer[length++] = mask >> 8;
+}
+
+void InputLog::startRecording(int quirkProfile, uint32_t seed, int instructionsPerFrame, uint16_t romChecksum) {
+    this->quirkProfile = quirkProfile;
+    this->seed = seed;
+    this->instructionsPerFrame = instructionsPerFrame;
+    this->romChecksum = romChecksum;
+    recording = true;
+    replaying = false;
+    full = size < INPUT_LOG_HEADER_SIZE + INPUT_LOG_CHECKSUM_SIZE;
+    length = INPUT_LOG_HEADER_SIZE;
+    frame = 0;
+    frames = 0;
+    entryFrame = 0;
+    keys = 0;
+}
+
+bool InputLog::startReplay(int length) {
+    int entries = length - INPUT_LOG_HEADER_SIZE - INPUT_LOG_CHECKSUM_SIZE;
+    if (entries < 0 || entries % INPUT_LOG_ENTRY_SIZE != 0) {
+        return false;
+    }
+    int body = length - INPUT_LOG_CHECKSUM_SIZE;
+    if (Snapshot::checksum(buffer, body) != (buffer[body] | (buffer[body + 1] << 8))) {
+        return false;
+    }
+    StateReader in(buffer, body);
+    for (unsigned int i = 0; i < sizeof(INPUT_LOG_MAGIC); i++) {
+        if (in.getByte() != INPUT_LOG_MAGIC[i]) {
+            return false;
+        }
+    }
+    if (in.getByte() != INPUT_LOG_VERSION) {
+        return false;
+    }
+    quirkProfile = in.getByte();
+    if (quirkProfile >= PROFILE_COUNT) {
+        return false;
+    }
+    uint32_t low = in.getWord();
+    seed = low | ((uint32_t)in.getWord() << 16);
+    instructionsPerFrame = in.getWord();
+    romChecksum = in.getWord();
+    low = in.getWord();
+    frames = low | ((uint32_t)in.getWord() << 16);
+
+    this->length = body;
+    position = INPUT_LOG_HEADER_SIZE;
+    recording = false;
+    replaying = true;
+    full = false;
+    frame = 0;
+    entryFrame = 0;
+    keys = 0;
+    return true;
+}
+
+void InputLog::step(Keyboard &keyboard) {
+    if (replaying) {
+        while (position + INPUT_LOG_ENTRY_SIZE <= length
+            && entryFrame + (buffer[position] | (buffer[position + 1] << 8)) == frame) {
+            keys = buffer[position + 2] | (buffer[position + 3] << 8);
+            entryFrame = frame;
+            position += INPUT_LOG_ENTRY_SIZE;
+        }
+        keyboard.setKeys(keys);
+    } else {
+        keyboard.scan();
+        if (recording && !full) {
+            uint16_t mask = keyboard.getKeys();
+            if (mask != keys || frame - entryFrame == INPUT_LOG_MAX_GAP) {
+                putEntry(frame - entryFrame, mask);
+                entryFrame = frame;
+                keys = mask;
+            }
+            if (!full) {
+                frames = frame + 1;
+            }
+        }
+    }
+    frame++;
+}
+
+bool InputLog::save(Storage &storage, const char *name) {
+    if (!recording) {
+        return false;
+    }
+    putHeader();
+    uint16_t sum = Snapshot::checksum(buffer, length);
+    buffer[length] = sum & 0xFF;
+    buffer[length + 1] = sum >> 8;
+    return storage.write(name, buffer, getLength()) == getLength();
+}
+
+bool InputLog::load(Storage &storage, const char *name) {
+    int length = storage.read(name, buffer, size);
+    return length > 0 && startReplay(length);
+}
+
+int InputLog::getQuirkProfile() {
+    return quirkProfile;
+}
+
+uint32_t InputLog::getSeed() {
+    return seed;
+}
+
+int InputLog::getInstructionsPerFrame() {
+    return instructionsPerFrame;
+}
+
+uint16_t InputLog::getRomChecksum() {
+    return romChecksum;
+}
+
+unsigned long InputLog::getFrames() {
+    return frames;
+}
+
+int InputLog::getLength() {
+    return length + INPUT_LOG_CHECKSUM_SIZE;
+}
+
+bool InputLog::isFull() {
+    return full;
+}
+
+bool InputLog::isFinished() {
+    return replaying && frame >= frames;
+}
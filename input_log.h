@@ -0,0 +1,166 @@
+#ifndef INPUT_LOG_H_INCLUDED
+#define INPUT_LOG_H_INCLUDED
+
+#include "hal.h"
+#include "keyboard.h"
+
+// Format version written, logs of other versions are refused
+#define INPUT_LOG_VERSION 2
+// Size of the header: magic, version, quirk profile, seed, instructions
+// per frame, ROM checksum, frames
+#define INPUT_LOG_HEADER_SIZE 18
+// Size of an entry: frames since the previous entry, keys
+#define INPUT_LOG_ENTRY_SIZE 4
+// Size of the checksum ending a log
+#define INPUT_LOG_CHECKSUM_SIZE 2
+// Most frames between two entries, longer gaps repeat the keys
+#define INPUT_LOG_MAX_GAP 0xFFFF
+
+/**
+ * Log of keys held in each frame of a run from reset, with the quirk
+ * profile, the seed of the CXNN generator and the speed, so that the run
+ * can be repeated exactly. Recorded on the board, replayed on the host.
+ *
+ * The log is kept in a buffer in its file layout, little-endian: magic
+ * "C8IL", version, quirk profile, seed, instructions per frame, checksum of the memory
+ * the ROM was loaded to, number of frames, then one entry of frames since
+ * the previous entry and debounced keys per change, and a Fletcher-16
+ * checksum. A key press and release take 8 bytes.
+ */
+class InputLog {
+    private:
+        // Log in its file layout
+        byte *buffer;
+        int size;
+        // Bytes of the buffer in use, header included
+        int length;
+
+        bool recording;
+        bool replaying;
+        // Set when an entry did not fit, frames after it are not logged
+        bool full;
+
+        int quirkProfile;
+        uint32_t seed;
+        int instructionsPerFrame;
+        uint16_t romChecksum;
+
+        // Frame step() is called for next
+        unsigned long frame;
+        // Frames recorded, or frames in the replayed log
+        unsigned long frames;
+        // Frame of the last entry and keys it holds
+        unsigned long entryFrame;
+        uint16_t keys;
+        // Offset of the next entry replayed
+        int position;
+
+        /**
+         * Appends an entry, marking the log full if it does not fit.
+         *
+         * @param gap Frames since the previous entry
+         * @param mask Keys held
+         */
+        void putEntry(uint16_t gap, uint16_t mask);
+
+        /**
+         * Writes the header to the buffer.
+         */
+        void putHeader();
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param buffer Buffer the log is kept in
+         * @param size Size of the buffer
+         */
+        InputLog(byte *buffer, int size);
+
+        /**
+         * Starts recording a run from reset, dropping the log.
+         *
+         * @param quirkProfile Quirk profile of the CPU, one of QuirkProfile
+         * @param seed Seed the CPU random generator was given
+         * @param instructionsPerFrame Instructions executed per frame
+         * @param romChecksum Snapshot::checksum() of memory with the ROM loaded
+         */
+        void startRecording(int quirkProfile, uint32_t seed, int instructionsPerFrame, uint16_t romChecksum);
+
+        /**
+         * Starts replaying the log in the buffer.
+         *
+         * @param length Length of the log
+         * @return <code>true</code> if the log is valid, <code>false</code> otherwise
+         */
+        bool startReplay(int length);
+
+        /**
+         * Sets keys of the next frame. Scans the keypad and logs the keys
+         * when recording, sets the logged keys when replaying.
+         * Called by the scheduler at the start of each frame.
+         *
+         * @param keyboard Keyboard of the CPU
+         */
+        void step(Keyboard &keyboard);
+
+        /**
+         * Writes the log recorded so far to a file.
+         *
+         * @param storage Storage to write to
+         * @param name Name/path of the file
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        bool save(Storage &storage, const char *name);
+
+        /**
+         * Reads a log from a file and starts replaying it.
+         *
+         * @param storage Storage to read from
+         * @param name Name/path of the file
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        bool load(Storage &storage, const char *name);
+
+        /**
+         * @return Quirk profile of the CPU, one of QuirkProfile
+         */
+        int getQuirkProfile();
+
+        /**
+         * @return Seed of the CPU random generator
+         */
+        uint32_t getSeed();
+
+        /**
+         * @return Instructions executed per frame
+         */
+        int getInstructionsPerFrame();
+
+        /**
+         * @return Checksum of memory with the ROM loaded
+         */
+        uint16_t getRomChecksum();
+
+        /**
+         * @return Number of frames recorded, or in the replayed log
+         */
+        unsigned long getFrames();
+
+        /**
+         * @return Length of the log in bytes, checksum included
+         */
+        int getLength();
+
+        /**
+         * @return <code>true</code> if the buffer filled up while recording, <code>false</code> otherwise
+         */
+        bool isFull();
+
+        /**
+         * @return <code>true</code> if all logged frames were replayed, <code>false</code> otherwise
+         */
+        bool isFinished();
+};
+
+#endif
@@ -1,16 +1,78 @@
 #include "keyboard.h"
 
-Keyboard::Keyboard(byte rowPins[], byte colPins[]) : keypad(makeKeymap(hexaKeys), rowPins, colPins, ROWS, COLS) {}
-
-char Keyboard::getKeyPressed() {
-    char theKey = keypad.getKey();
-    if (theKey) {
-        key = theKey;
-    } else {
-        if (keypad.getState() != PRESSED and keypad.getState() != HOLD) {
-            key = NO_KEY_PRESSED;
+#include <stddef.h>
+
+Keyboard::Keyboard(Input &input, Clock &clock, uint32_t debounceTime) : input(input), clock(clock), debounceTime(debounceTime) {
+    keys = 0;
+    candidate = 0;
+    candidateTime = 0;
+    eventHead = 0;
+    eventTail = 0;
+    latency = NULL;
+}
+
+void Keyboard::scan() {
+    uint32_t now = clock.micros();
+    uint16_t raw = input.scan();
+    if (raw != candidate) {
+        candidate = raw;
+        candidateTime = now;
+    }
+    if (candidate == keys || now - candidateTime < debounceTime) {
+        return;
+    }
+    accept(candidate, candidateTime);
+}
+
+void Keyboard::setKeys(uint16_t mask) {
+    candidate = mask;
+    candidateTime = clock.micros();
+    if (candidate != keys) {
+        accept(candidate, candidateTime);
+    }
+}
+
+void Keyboard::accept(uint16_t state, uint32_t time) {
+    uint16_t changed = state ^ keys;
+    for (int key = 0; key < NUM_KEYS; key++) {
+        if ((changed >> key) & 1) {
+            KeyEvent event;
+            event.time = time;
+            event.key = key;
+            event.pressed = (state >> key) & 1;
+            pushEvent(event);
+            if (latency) {
+                latency->onEdge(key, time);
+            }
         }
     }
-    return key;
+    keys = state;
 }
 
+void Keyboard::pushEvent(const KeyEvent &event) {
+    events[eventHead] = event;
+    eventHead = (eventHead + 1) & (KEY_QUEUE_SIZE - 1);
+    if (eventHead == eventTail) {
+        eventTail = (eventTail + 1) & (KEY_QUEUE_SIZE - 1);
+    }
+}
+
+bool Keyboard::getEvent(KeyEvent &event) {
+    if (eventHead == eventTail) {
+        return false;
+    }
+    event = events[eventTail];
+    eventTail = (eventTail + 1) & (KEY_QUEUE_SIZE - 1);
+    if (latency) {
+        latency->onTest(event.key);
+    }
+    return true;
+}
+
+void Keyboard::clearEvents() {
+    eventTail = eventHead;
+}
+
+void Keyboard::setLatency(InputLatency *latency) {
+    this->latency = latency;
+}
@@ -1,11 +1,20 @@
 #ifndef KEYBOARD_H_INCLUDED
 #define KEYBOARD_H_INCLUDED
 
-#include <Keypad.h>
+#include "hal.h"
+#include "latency.h"
 
 #define ROWS 4
 #define COLS 4
-#define NO_KEY_PRESSED 0
+// Number of keys
+#define NUM_KEYS 16
+// Key value meaning no key
+#define NO_KEY_PRESSED 0xFF
+
+// Time a key has to stay in new state before change is accepted (us)
+#define DEBOUNCE_TIME 10000
+// Number of queued key events, power of two
+#define KEY_QUEUE_SIZE 16
 
 // Map of hexa keyboard used by CHIP-8
 static const char hexaKeys[ROWS][COLS] = {
@@ -16,25 +25,126 @@ static const char hexaKeys[ROWS][COLS] = {
 };
 
 /**
- * Class for keyboard controlling and mapping
+ * Debounced key press or release.
+ */
+struct KeyEvent {
+    // Time key first changed state (us)
+    uint32_t time;
+    // Key, 0-F
+    byte key;
+    // true for a press, false for a release
+    bool pressed;
+};
+
+/**
+ * Class for keyboard controlling and mapping.
+ *
+ * Keypad is scanned in the background by scan(), outside of instruction
+ * execution. Debounced state of all keys is kept as a 16-bit mask and
+ * every change is queued as a timestamped KeyEvent.
  */
 class Keyboard {
     private:
-        Keypad keypad;
-        char key = 0;
-        
+        // Keypad backend
+        Input &input;
+        // Time source for debouncing and event times
+        Clock &clock;
+        // Time key has to stay in new state (us)
+        uint32_t debounceTime;
+
+        // Debounced keys, bit N set if key N is down
+        uint16_t keys;
+        // Last raw scan and time it first appeared
+        uint16_t candidate;
+        uint32_t candidateTime;
+
+        // Latency measurement, NULL if disabled
+        InputLatency *latency;
+
+        // Event ring buffer, oldest event is overwritten when full
+        KeyEvent events[KEY_QUEUE_SIZE];
+        byte eventHead;
+        byte eventTail;
+
+        /**
+         * Queues an event.
+         *
+         * @param event Event to be queued
+         */
+        void pushEvent(const KeyEvent &event);
+
+        /**
+         * Accepts new key states, queuing an event for every change.
+         *
+         * @param state Keys down, bit N set if key N is down
+         * @param time Time keys changed (us)
+         */
+        void accept(uint16_t state, uint32_t time);
+
     public:
         /**
          * Default constructor.
+         *
+         * @param input Keypad backend to read keys from
+         * @param clock Time source
+         * @param debounceTime Time key has to stay in new state (us)
+         */
+        Keyboard(Input &input, Clock &clock, uint32_t debounceTime = DEBOUNCE_TIME);
+
+        /**
+         * Scans the keypad, updates key states and queues changes.
+         * Called periodically from the main loop.
+         */
+        void scan();
+
+        /**
+         * Sets key states without scanning or debouncing, as replayed
+         * from an input log. Changes are queued as by scan().
+         *
+         * @param mask Keys down, bit N set if key N is down
+         */
+        void setKeys(uint16_t mask);
+
+        /**
+         * @return Debounced keys, bit N set if key N is down
+         */
+        inline uint16_t getKeys() {
+            return keys;
+        }
+
+        /**
+         * Returns whether key is down, as tested by the ROM.
+         * Only lowest four bits of key are used.
+         *
+         * @param key Key to be checked
+         * @return <code>true</code> if key is down, <code>false</code> otherwise
+         */
+        inline bool isKeyDown(byte key) {
+            if (latency) {
+                latency->onTest(key);
+            }
+            return (keys >> (key & 0xF)) & 1;
+        }
+
+        /**
+         * Takes the oldest queued event, as seen by the ROM.
+         *
+         * @param event Output
+         * @return <code>true</code> if there was an event, <code>false</code> otherwise
+         */
+        bool getEvent(KeyEvent &event);
+
+        /**
+         * Drops all queued events.
          */
-        Keyboard(byte rowPins[], byte colPins[]);
+        void clearEvents();
 
         /**
-         * Gets currently pressed key.
-         * 
-         * @return Currently pressed key
+         * Enables latency measurement.
+         *
+         * @param latency Measurement key edges are reported to, NULL to disable
          */
-        char getKeyPressed();
+        void setLatency(InputLatency *latency);
 };
 
 #endif
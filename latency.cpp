@@ -0,0 +1,80 @@
+#include "latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+InputLatency::InputLatency(Clock &clock) : clock(clock) {
+    reset();
+}
+
+void InputLatency::onEdge(byte key, uint32_t time) {
+    edgeTimes[key] = time;
+    untested |= 1 << key;
+}
+
+void InputLatency::recordTest(byte key) {
+    untested &= ~(1 << key);
+    add(testHistogram, clock.micros() - edgeTimes[key]);
+    // Newer edge replaces one still waiting for a frame
+    presentPending = true;
+    testedEdgeTime = edgeTimes[key];
+}
+
+void InputLatency::onPresent() {
+    if (!presentPending) {
+        return;
+    }
+    presentPending = false;
+    add(presentHistogram, clock.micros() - testedEdgeTime);
+}
+
+void InputLatency::reset() {
+    untested = 0;
+    presentPending = false;
+    memset(&testHistogram, 0, sizeof(testHistogram));
+    memset(&presentHistogram, 0, sizeof(presentHistogram));
+}
+
+const LatencyHistogram &InputLatency::getTestHistogram() {
+    return testHistogram;
+}
+
+const LatencyHistogram &InputLatency::getPresentHistogram() {
+    return presentHistogram;
+}
+
+void InputLatency::add(LatencyHistogram &histogram, uint32_t time) {
+    uint32_t bucket = time / LATENCY_BUCKET_WIDTH;
+    histogram.buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+    histogram.samples++;
+    histogram.total += time;
+    if (time > histogram.longest) {
+        histogram.longest = time;
+    }
+}
+
+void InputLatency::report(Log &log) {
+    report(log, "key edge to test", testHistogram);
+    report(log, "key edge to frame", presentHistogram);
+}
+
+void InputLatency::report(Log &log, const char *name, const LatencyHistogram &histogram) {
+    char line[96];
+    unsigned long mean = histogram.samples ? (unsigned long)(histogram.total / histogram.samples) : 0;
+    snprintf(line, sizeof(line), "%s: %lu samples, mean %lu us, max %lu us\n", name,
+        (unsigned long)histogram.samples, mean, (unsigned long)histogram.longest);
+    log.print(line);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (!histogram.buckets[i]) {
+            continue;
+        }
+        if (i < LATENCY_BUCKETS - 1) {
+            snprintf(line, sizeof(line), "  %2d-%2d ms: %lu\n", i * LATENCY_BUCKET_WIDTH / 1000,
+                (i + 1) * LATENCY_BUCKET_WIDTH / 1000, (unsigned long)histogram.buckets[i]);
+        } else {
+            snprintf(line, sizeof(line), "  %2d+ ms: %lu\n", i * LATENCY_BUCKET_WIDTH / 1000,
+                (unsigned long)histogram.buckets[i]);
+        }
+        log.print(line);
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef LATENCY_H_INCLUDED
+#define LATENCY_H_INCLUDED
+
+#include "hal.h"
+
+// Number of keys tracked
+#define LATENCY_KEYS 16
+// Number of histogram buckets, the last one collects everything longer
+#define LATENCY_BUCKETS 16
+// Width of a histogram bucket (us)
+#define LATENCY_BUCKET_WIDTH 4000
+
+/**
+ * Distribution of measured times.
+ */
+struct LatencyHistogram {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t samples;
+    // Sum and maximum of samples (us)
+    uint64_t total;
+    uint32_t longest;
+};
+
+/**
+ * Measures input latency.
+ *
+ * Each debounced key edge is timestamped with the time it was first
+ * scanned. Two times are measured from it: until the ROM first tests
+ * the key (EX9E, EXA1, FX0A), and until the next presented frame that
+ * changed pixels after that test.
+ */
+class InputLatency {
+    private:
+        Clock &clock;
+
+        // Time of the latest edge of each key not yet tested by the ROM (us)
+        uint32_t edgeTimes[LATENCY_KEYS];
+        // Keys with an edge not yet tested, bit N for key N
+        uint16_t untested;
+
+        // Set when a tested edge waits for a frame to be presented
+        bool presentPending;
+        // Time of that edge (us)
+        uint32_t testedEdgeTime;
+
+        // Edge to first test by the ROM
+        LatencyHistogram testHistogram;
+        // Edge to first presented frame with changed pixels
+        LatencyHistogram presentHistogram;
+
+        /**
+         * Records the first test of a key edge.
+         *
+         * @param key Key tested
+         */
+        void recordTest(byte key);
+
+        /**
+         * Adds a sample to a histogram.
+         *
+         * @param histogram Histogram to be updated
+         * @param time Measured time (us)
+         */
+        static void add(LatencyHistogram &histogram, uint32_t time);
+
+        /**
+         * Prints one histogram.
+         *
+         * @param log Output
+         * @param name Name of the measured time
+         * @param histogram Histogram to be printed
+         */
+        static void report(Log &log, const char *name, const LatencyHistogram &histogram);
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param clock Time source edges are timestamped with
+         */
+        InputLatency(Clock &clock);
+
+        /**
+         * Called by Keyboard when a key changes state.
+         *
+         * @param key Key, 0-F
+         * @param time Time change was first scanned (us)
+         */
+        void onEdge(byte key, uint32_t time);
+
+        /**
+         * Called by Keyboard when the ROM tests a key.
+         *
+         * @param key Key tested
+         */
+        inline void onTest(byte key) {
+            if ((untested >> (key & 0xF)) & 1) {
+                recordTest(key & 0xF);
+            }
+        }
+
+        /**
+         * Called by Screen when a frame with changed pixels is shown.
+         */
+        void onPresent();
+
+        /**
+         * Drops all samples.
+         */
+        void reset();
+
+        /**
+         * @return Edge to first test histogram
+         */
+        const LatencyHistogram &getTestHistogram();
+
+        /**
+         * @return Edge to first presented frame histogram
+         */
+        const LatencyHistogram &getPresentHistogram();
+
+        /**
+         * Prints both histograms.
+         *
+         * @param log Output
+         */
+        void report(Log &log);
+};
+
+#endif
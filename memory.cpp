@@ -1,14 +1,32 @@
 #include "memory.h"
 
-Memory::Memory(int pinSD, byte *memory) : pinSD(pinSD), memory(memory) {
+#include "snapshot.h"
+
+Memory::Memory(Storage &storage, byte *memory) : storage(storage), memory(memory) {
+    numObservers = 0;
     loadFonts();
     romLoaded = false;
 }
 
+void Memory::notify(int location, int length) {
+    for (int i = 0; i < numObservers; i++) {
+        observers[i]->onMemoryWrite(location, length);
+    }
+}
+
+bool Memory::addObserver(MemoryObserver *observer) {
+    if (numObservers == MAX_OBSERVERS) {
+        return false;
+    }
+    observers[numObservers++] = observer;
+    return true;
+}
+
 void Memory::clearMemory() {
     for (int i = 0; i < MEMORY_SIZE; i++) {
         memory[i] = 0x0;
     }
+    notify(0, MEMORY_SIZE);
 }
 
 void Memory::loadFonts() {
@@ -47,38 +65,52 @@ void Memory::loadFonts() {
 }
 
 byte Memory::getByte(int location) {
-    if (location < MEMORY_SIZE)
+    // Negative locations wrap to large unsigned ones and are rejected too
+    if ((unsigned)location < MEMORY_SIZE)
         return memory[location];
     else return 0;
 }
 
 void Memory::setByte(int location, byte value) {
-    if (location < MEMORY_SIZE)
+    if ((unsigned)location < MEMORY_SIZE) {
         memory[location] = value;
+        notify(location, 1);
+    }
+}
+
+void Memory::saveState(StateWriter &out) {
+    out.putPacked(memory, MEMORY_SIZE);
+}
+
+void Memory::loadState(StateReader &in) {
+    in.getPacked(memory, MEMORY_SIZE);
+    notify(0, MEMORY_SIZE);
 }
 
 bool Memory::initialize() {
-    if (!SD.begin(pinSD)) {
+    return storage.begin();
+}
+
+bool Memory::loadRom(const char *romName) {
+    int length = storage.read(romName, memory + ROM_OFFSET, MEMORY_SIZE - ROM_OFFSET);
+    if (length < 0) {
         return false;
     }
+    notify(ROM_OFFSET, length);
+    romLoaded = true;
     return true;
 }
 
-bool Memory::loadRom(String romName) {
-    File rom = SD.open(romName, FILE_READ);
-    if (!rom) {
+bool Memory::loadRom(const byte *rom, int length) {
+    if (length < 0 || length > MEMORY_SIZE - ROM_OFFSET) {
         return false;
     }
-
-    int i = ROM_OFFSET;
-
-    while (rom.available()) {
-        setByte(i++, rom.read());
+    for (int i = 0; i < length; i++) {
+        memory[ROM_OFFSET + i] = rom[i];
     }
-    rom.close();
+    notify(ROM_OFFSET, length);
     romLoaded = true;
     return true;
-
 }
 
 /*
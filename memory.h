@@ -1,26 +1,54 @@
 #ifndef MEMORY_H_INCLUDED
 #define MEMORY_H_INCLUDED
 
-#include <Arduino.h>
-#include <SD.h>
-#include <SPI.h>
-
-typedef unsigned char byte;
+#include "hal.h"
 
 #define MEMORY_SIZE 0x1000
 #define ROM_OFFSET 0x200
+// Maximal number of memory observers
+#define MAX_OBSERVERS 4
+
+class StateWriter;
+class StateReader;
+
+/**
+ * Gets notified about memory writes.
+ */
+class MemoryObserver {
+    public:
+        virtual ~MemoryObserver() {}
+
+        /**
+         * Called after memory was written to.
+         *
+         * @param location First location written to
+         * @param length Number of bytes written
+         */
+        virtual void onMemoryWrite(int location, int length) = 0;
+};
 
 /**
  * Controls memory usage.
  */
 class Memory {
     private:
-        // Number of pin SD card is connected to
-        int pinSD;
+        // Storage ROMs are loaded from
+        Storage &storage;
         // Byte array representig CHIP-8 memory
         byte *memory;
         // ROM loaded indicator
         bool romLoaded;
+        // Observers notified about writes
+        MemoryObserver *observers[MAX_OBSERVERS];
+        int numObservers;
+
+        /**
+         * Notifies observers about a write.
+         *
+         * @param location First location written to
+         * @param length Number of bytes written
+         */
+        void notify(int location, int length);
 
         /**
          * Closes the ROM and clears the memory for next one.
@@ -36,10 +64,10 @@ class Memory {
         /**
          * Default constructor for Emulator.Memory object.
          * 
-         * @param pinSD Number of pin SD card is connected to
+         * @param storage Storage ROMs are loaded from
          * @param memory Byte array representig memory
          */
-        Memory(int pinSD, byte* memory);
+        Memory(Storage &storage, byte* memory);
 
         /**
          * Gets the byte from given location
@@ -58,7 +86,15 @@ class Memory {
         void setByte(int location, byte value);
 
         /**
-         * Initializes the SD card.
+         * Registers observer to be notified about writes.
+         *
+         * @param observer Observer to be added
+         * @return <code>true</code> if observer was added, <code>false</code> if there is no room
+         */
+        bool addObserver(MemoryObserver *observer);
+
+        /**
+         * Initializes the storage.
          * 
          * @return @return <code>true</code> if operation is successful, <code>false</code> otherwise
          */
@@ -67,10 +103,19 @@ class Memory {
         /**
          * Loads the ROM into the memory.
          *
-         * @param romName Name/path of rom on the SD card
+         * @param romName Name/path of rom in the storage
          * @return <code>true</code> if operation is successful, <code>false</code> otherwise
          */
-        bool loadRom(String romName);
+        bool loadRom(const char *romName);
+
+        /**
+         * Loads the ROM from given bytes into the memory.
+         *
+         * @param rom ROM contents
+         * @param length Size of the ROM
+         * @return <code>true</code> if operation is successful, <code>false</code> if ROM does not fit
+         */
+        bool loadRom(const byte *rom, int length);
 
         /**
          * Closes the ROM and clears the memory for next one.
@@ -81,6 +126,20 @@ class Memory {
          * @return <code>true</code> if ROM is loaded, <code>false</code> otherwise
          */
         bool isRomLoaded();
+
+        /**
+         * Writes whole memory run-length encoded.
+         *
+         * @param out Snapshot being written
+         */
+        void saveState(StateWriter &out);
+
+        /**
+         * Reads memory written by saveState() and notifies the observers.
+         *
+         * @param in Snapshot being read
+         */
+        void loadState(StateReader &in);
         
 };
 
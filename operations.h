@@ -0,0 +1,43 @@
+// Handlers of decoded instructions, in Operation order.
+//
+// OPERATION(name, body) is defined by the includer. Body is a CPU
+// member statement using the decoded Instruction named instruction and
+// the quirk flags of the core named QUIRKS. STOP_RUN ends the run
+// early and is defined by the includer as well.
+// No include guard, file is included once per use.
+
+OPERATION(OP_NOP, )                                                                     // Unknown opcode, ignored
+OPERATION(OP_CLEAR_SCREEN, clearScreen())                                               // 00E0
+OPERATION(OP_RETURN, returnFromSubrutine())                                             // 00EE
+OPERATION(OP_JUMP, jumpToAddress(instruction.nnn))                                      // 1NNN
+OPERATION(OP_CALL, callSubroutine(instruction.nnn))                                     // 2NNN
+OPERATION(OP_SKIP_EQUAL_VALUE, skipIfRegisterEqualValue(instruction.x, instruction.nn))         // 3XNN
+OPERATION(OP_SKIP_NOT_EQUAL_VALUE, skipIfRegisterNotEqualValue(instruction.x, instruction.nn))  // 4XNN
+OPERATION(OP_SKIP_EQUAL_REGISTER, skipIfRegisterEqualRegister(instruction.x, instruction.y))    // 5XY0
+OPERATION(OP_SET_VALUE, setRegisterToValue(instruction.x, instruction.nn))              // 6XNN
+OPERATION(OP_ADD_VALUE, addValueToRegister(instruction.x, instruction.nn))              // 7XNN
+OPERATION(OP_MOVE, registerMove(instruction.x, instruction.y))                          // 8XY0
+OPERATION(OP_OR, registerOr<QUIRKS>(instruction.x, instruction.y))                      // 8XY1
+OPERATION(OP_AND, registerAnd<QUIRKS>(instruction.x, instruction.y))                    // 8XY2
+OPERATION(OP_XOR, registerXor<QUIRKS>(instruction.x, instruction.y))                    // 8XY3
+OPERATION(OP_ADD, registerAdd(instruction.x, instruction.y))                            // 8XY4
+OPERATION(OP_SUB_N, registerSubN(instruction.x, instruction.y))                         // 8XY5
+OPERATION(OP_SHIFT_RIGHT, registerShiftRight<QUIRKS>(instruction.x, instruction.y))     // 8XY6
+OPERATION(OP_SUB, registerSub(instruction.x, instruction.y))                            // 8XY7
+OPERATION(OP_SHIFT_LEFT, registerShiftLeft<QUIRKS>(instruction.x, instruction.y))       // 8XYE
+OPERATION(OP_SKIP_NOT_EQUAL_REGISTER, skipIfRegisterNotEqualRegister(instruction.x, instruction.y)) // 9XY0
+OPERATION(OP_SET_I, setIToAddress(instruction.nnn))                                     // ANNN
+OPERATION(OP_JUMP_PLUS_V0, jumpToAddressPlusV0<QUIRKS>(instruction.nnn))                // BNNN
+OPERATION(OP_RANDOM, setRegisterToRandomValue(instruction.x, instruction.nn))           // CXNN
+OPERATION(OP_DRAW, drawSprite<QUIRKS>(instruction.x, instruction.y, instruction.n))     // DXYN
+OPERATION(OP_SKIP_KEY_PRESSED, skipIfKeyPressed(instruction.x))                         // EX9E
+OPERATION(OP_SKIP_KEY_NOT_PRESSED, skipIfKeyNotPressed(instruction.x))                  // EXA1
+OPERATION(OP_GET_DELAY_TIMER, setRegisterToDelayTimer(instruction.x))                   // FX07
+OPERATION(OP_WAIT_FOR_KEY, if (!waitForKey(instruction.x)) STOP_RUN)                   // FX0A, run stops while waiting
+OPERATION(OP_SET_DELAY_TIMER, setDelayTimer(instruction.x))                             // FX15
+OPERATION(OP_SET_SOUND_TIMER, setSoundTimer(instruction.x))                             // FX18
+OPERATION(OP_ADD_TO_I, addRegisterToI(instruction.x))                                   // FX1E
+OPERATION(OP_LOAD_SPRITE, loadIWithSprite(instruction.x))                               // FX29
+OPERATION(OP_STORE_DECIMAL, storeDecimalInMemory(instruction.x))                        // FX33
+OPERATION(OP_STORE_REGISTERS, storeRegistersInMemory<QUIRKS>(instruction.x))            // FX55
+OPERATION(OP_LOAD_REGISTERS, storeMemoryToRegisters<QUIRKS>(instruction.x))             // FX65
@@ -0,0 +1,73 @@
+#include "presenter.h"
+
+Presenter::Presenter(Screen &screen, Clock &clock) : screen(screen), clock(clock) {
+    frameSkip = false;
+    maxSkip = DEFAULT_MAX_SKIP;
+    skipLeft = 0;
+#if CPU_PROFILE
+    profiler = NULL;
+#endif
+    resetCounters();
+}
+
+void Presenter::setFrameSkip(bool enabled, int maxSkip) {
+    frameSkip = enabled;
+    this->maxSkip = maxSkip;
+    skipLeft = 0;
+}
+
+void Presenter::tick() {
+    unsigned int draws = screen.getPendingDraws();
+    if (draws == 0) {
+        return;
+    }
+
+    if (frameSkip && skipLeft > 0) {
+        skipLeft--;
+        framesSkipped++;
+        return;
+    }
+
+    uint32_t start = clock.micros();
+    screen.show();
+    uint32_t cost = clock.micros() - start;
+#if CPU_PROFILE
+    if (profiler) {
+        profiler->recordPresent(cost);
+    }
+#endif
+
+    framesPresented++;
+    drawsCoalesced += draws - 1;
+
+    if (frameSkip && cost > PRESENT_BUDGET) {
+        skipLeft = cost / PRESENT_BUDGET;
+        if (skipLeft > maxSkip) {
+            skipLeft = maxSkip;
+        }
+    }
+}
+
+unsigned long Presenter::getFramesPresented() {
+    return framesPresented;
+}
+
+unsigned long Presenter::getFramesSkipped() {
+    return framesSkipped;
+}
+
+unsigned long Presenter::getDrawsCoalesced() {
+    return drawsCoalesced;
+}
+
+void Presenter::resetCounters() {
+    framesPresented = 0;
+    framesSkipped = 0;
+    drawsCoalesced = 0;
+}
+
+#if CPU_PROFILE
+void Presenter::setProfiler(Profiler *profiler) {
+    this->profiler = profiler;
+}
+#endif
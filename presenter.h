@@ -0,0 +1,95 @@
+#ifndef PRESENTER_H_INCLUDED
+#define PRESENTER_H_INCLUDED
+
+#include "hal.h"
+#include "screen.h"
+#include "profiler.h"
+
+// Length of one frame (us), screen is shown at most once per frame
+#define FRAME_TIME 16667
+// Time showing the screen may take before frames are skipped (us)
+#define PRESENT_BUDGET (FRAME_TIME / 2)
+// Default maximal number of frames skipped in a row
+#define DEFAULT_MAX_SKIP 2
+
+/**
+ * Presentation scheduler.
+ *
+ * Draws made during a frame are coalesced and the screen is shown
+ * at most once per 60 Hz tick, driven by the Scheduler. With frame skip enabled, frames are
+ * left out after a show that took longer than PRESENT_BUDGET.
+ */
+class Presenter {
+    private:
+        Screen &screen;
+        Clock &clock;
+
+        // Frame skip settings
+        bool frameSkip;
+        int maxSkip;
+        // Frames still to be skipped
+        int skipLeft;
+
+#if CPU_PROFILE
+        // Profile screen shows are recorded in, NULL if none
+        Profiler *profiler;
+#endif
+
+        // Counters
+        unsigned long framesPresented;
+        unsigned long framesSkipped;
+        unsigned long drawsCoalesced;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param screen Screen to be shown
+         * @param clock Time source
+         */
+        Presenter(Screen &screen, Clock &clock);
+
+        /**
+         * Enables or disables frame skip.
+         *
+         * @param enabled <code>true</code> to enable frame skip
+         * @param maxSkip Maximal number of frames skipped in a row
+         */
+        void setFrameSkip(bool enabled, int maxSkip = DEFAULT_MAX_SKIP);
+
+        /**
+         * Ends a frame, shows the screen if it was drawn to.
+         */
+        void tick();
+
+        /**
+         * @return Number of frames shown
+         */
+        unsigned long getFramesPresented();
+
+        /**
+         * @return Number of frames with draws that were not shown
+         */
+        unsigned long getFramesSkipped();
+
+        /**
+         * @return Number of draws that did not need a show of their own
+         */
+        unsigned long getDrawsCoalesced();
+
+        /**
+         * Sets all counters to zero.
+         */
+        void resetCounters();
+
+#if CPU_PROFILE
+        /**
+         * Records time of screen shows.
+         *
+         * @param profiler Profile to be recorded, NULL to stop
+         */
+        void setProfiler(Profiler *profiler);
+#endif
+};
+
+#endif
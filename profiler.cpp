@@ -0,0 +1,114 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Names of operations, in Operation order
+static const char *const operationNames[] = {
+#define OPERATION(op, body) #op,
+#include "operations.h"
+#undef OPERATION
+};
+
+Profiler::Profiler() {
+    reset();
+}
+
+void Profiler::recordPresent(uint32_t elapsed) {
+    presents++;
+    presentTime += elapsed;
+    if (elapsed > longestPresent) {
+        longestPresent = elapsed;
+    }
+}
+
+void Profiler::reset() {
+    memset(counts, 0, sizeof(counts));
+    memset(cycles, 0, sizeof(cycles));
+    memset(pcSamples, 0, sizeof(pcSamples));
+    untilSample = PROFILE_SAMPLE_INTERVAL;
+    presents = 0;
+    presentTime = 0;
+    longestPresent = 0;
+}
+
+uint32_t Profiler::getCount(int op) {
+    return counts[op];
+}
+
+uint64_t Profiler::getCycles(int op) {
+    return cycles[op];
+}
+
+/**
+ * Returns value * 1000 / total, for printing tenths of percent
+ * without floating point printf support on the board.
+ *
+ * @param value Part
+ * @param total Whole
+ * @return Tenths of percent
+ */
+static unsigned long permille(uint64_t value, uint64_t total) {
+    return total ? (unsigned long)(value * 1000 / total) : 0;
+}
+
+void Profiler::report(Log &log) {
+    char line[128];
+
+    uint64_t totalCycles = 0;
+    uint32_t totalCount = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        totalCycles += cycles[op];
+        totalCount += counts[op];
+    }
+    // Cycles are printed in thousands, printf on the board has no 64-bit support
+    snprintf(line, sizeof(line), "instructions: %lu, kcycles: %lu\n", (unsigned long)totalCount, (unsigned long)(totalCycles / 1000));
+    log.print(line);
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (!counts[op]) {
+            continue;
+        }
+        unsigned long perRun = (unsigned long)(cycles[op] * 10 / counts[op]);
+        unsigned long share = permille(cycles[op], totalCycles);
+        snprintf(line, sizeof(line), "  %-28s %10lu runs %10lu kcycles %6lu.%lu/run %3lu.%lu%%\n",
+            operationNames[op], (unsigned long)counts[op], (unsigned long)(cycles[op] / 1000),
+            perRun / 10, perRun % 10, share / 10, share % 10);
+        log.print(line);
+    }
+
+    uint32_t samples = 0;
+    for (int i = 0; i < PROFILE_PC_BUCKETS; i++) {
+        samples += pcSamples[i];
+    }
+    snprintf(line, sizeof(line), "pc samples: %lu, every %d instructions\n", (unsigned long)samples, PROFILE_SAMPLE_INTERVAL);
+    log.print(line);
+    // Selects hottest buckets without sorting the whole histogram
+    uint32_t previous = 0xFFFFFFFF;
+    int reported = 0;
+    while (reported < PROFILE_HOT_BUCKETS) {
+        int hottest = -1;
+        for (int i = 0; i < PROFILE_PC_BUCKETS; i++) {
+            if (pcSamples[i] && pcSamples[i] < previous && (hottest < 0 || pcSamples[i] > pcSamples[hottest])) {
+                hottest = i;
+            }
+        }
+        if (hottest < 0) {
+            break;
+        }
+        previous = pcSamples[hottest];
+        // Report every bucket with the same number of samples
+        for (int i = 0; i < PROFILE_PC_BUCKETS && reported < PROFILE_HOT_BUCKETS; i++) {
+            if (pcSamples[i] == previous) {
+                unsigned long share = permille(pcSamples[i], samples);
+                snprintf(line, sizeof(line), "  %03X-%03X: %lu (%lu.%lu%%)\n", i * PROFILE_PC_BUCKET_SIZE,
+                    (i + 1) * PROFILE_PC_BUCKET_SIZE - 1, (unsigned long)pcSamples[i], share / 10, share % 10);
+                log.print(line);
+                reported++;
+            }
+        }
+    }
+
+    snprintf(line, sizeof(line), "screen shows: %lu, mean %lu us, max %lu us\n", (unsigned long)presents,
+        presents ? (unsigned long)(presentTime / presents) : 0UL, (unsigned long)longestPresent);
+    log.print(line);
+}
@@ -0,0 +1,99 @@
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+#include <stddef.h>
+
+#include "hal.h"
+#include "memory.h"
+#include "decoder.h"
+
+// Set to 1 to build the profiling hooks into CPU and Presenter
+#ifndef CPU_PROFILE
+#define CPU_PROFILE 0
+#endif
+
+// Instructions between two PC samples
+#define PROFILE_SAMPLE_INTERVAL 64
+// Bytes of memory covered by one PC histogram bucket
+#define PROFILE_PC_BUCKET_SIZE 16
+// Number of PC histogram buckets
+#define PROFILE_PC_BUCKETS (MEMORY_SIZE / PROFILE_PC_BUCKET_SIZE)
+// Number of hottest buckets reported
+#define PROFILE_HOT_BUCKETS 8
+
+/**
+ * Execution profile of a ROM.
+ *
+ * Counts executions and cycles (Clock::cycles()) per Operation, keeps
+ * a histogram of PC sampled every PROFILE_SAMPLE_INTERVAL instructions
+ * and times showing the screen. Filled by CPU and Presenter when they
+ * are built with CPU_PROFILE and a profiler is attached.
+ */
+class Profiler {
+    private:
+        // Per Operation
+        uint32_t counts[OP_COUNT];
+        uint64_t cycles[OP_COUNT];
+
+        // Sampled PC histogram
+        uint32_t pcSamples[PROFILE_PC_BUCKETS];
+        // Instructions left until the next sample
+        int untilSample;
+
+        // Screen shows, time they took (us)
+        uint32_t presents;
+        uint64_t presentTime;
+        uint32_t longestPresent;
+
+    public:
+        Profiler();
+
+        /**
+         * Records an executed instruction.
+         *
+         * @param op Operation of the instruction
+         * @param pc Location of the instruction
+         * @param elapsed Cycles execution took
+         */
+        inline void record(int op, int pc, uint32_t elapsed) {
+            counts[op]++;
+            cycles[op] += elapsed;
+            if (--untilSample <= 0) {
+                untilSample = PROFILE_SAMPLE_INTERVAL;
+                pcSamples[(pc & (MEMORY_SIZE - 1)) / PROFILE_PC_BUCKET_SIZE]++;
+            }
+        }
+
+        /**
+         * Records showing the screen.
+         *
+         * @param elapsed Time show took (us)
+         */
+        void recordPresent(uint32_t elapsed);
+
+        /**
+         * Drops everything recorded.
+         */
+        void reset();
+
+        /**
+         * @param op One of Operation
+         * @return Number of executions of the operation
+         */
+        uint32_t getCount(int op);
+
+        /**
+         * @param op One of Operation
+         * @return Cycles spent in the operation
+         */
+        uint64_t getCycles(int op);
+
+        /**
+         * Prints the profile: operations, hottest PC ranges and screen shows.
+         *
+         * @param log Output
+         */
+        void report(Log &log);
+};
+
+#endif
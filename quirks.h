@@ -0,0 +1,42 @@
+#ifndef QUIRKS_H_INCLUDED
+#define QUIRKS_H_INCLUDED
+
+// Behaviours CHIP-8 interpreters disagree on, one bit each. The CPU
+// core is compiled once per profile with its quirks as constants.
+
+// 8XY1, 8XY2 and 8XY3 set VF to 0
+#define QUIRK_VF_RESET 0x01
+// 8XY6 and 8XYE shift VY into VX, rather than shifting VX
+#define QUIRK_SHIFT_VY 0x02
+// FX55 and FX65 leave I past the last register (I += X + 1)
+#define QUIRK_INCREMENT_I 0x04
+// FX55 and FX65 leave I on the last register (I += X)
+#define QUIRK_INCREMENT_I_BY_X 0x08
+// BXNN jumps to XNN plus VX, rather than BNNN to NNN plus V0
+#define QUIRK_JUMP_VX 0x10
+// DXYN clips sprites at the screen edges, rather than wrapping them
+#define QUIRK_CLIP 0x20
+
+// Quirks of each profile
+#define MODERN_QUIRKS 0
+#define COSMAC_VIP_QUIRKS (QUIRK_VF_RESET | QUIRK_SHIFT_VY | QUIRK_INCREMENT_I | QUIRK_CLIP)
+#define CHIP48_QUIRKS (QUIRK_INCREMENT_I_BY_X | QUIRK_JUMP_VX | QUIRK_CLIP)
+#define SCHIP_QUIRKS (QUIRK_JUMP_VX | QUIRK_CLIP)
+
+/**
+ * Interpreters whose behaviour can be emulated, selected once at ROM
+ * load. Modern is what most ROMs written today expect.
+ */
+enum QuirkProfile {
+    // No quirks
+    PROFILE_MODERN,
+    // Original interpreter of the COSMAC VIP
+    PROFILE_COSMAC_VIP,
+    // CHIP-48 on the HP-48
+    PROFILE_CHIP48,
+    // SUPER-CHIP 1.1
+    PROFILE_SCHIP,
+    PROFILE_COUNT
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(CPU &cpu, Keyboard &keyboard, Presenter &presenter, FrameTimer &timer, int instructionsPerFrame) : cpu(cpu), keyboard(keyboard), presenter(presenter), timer(timer), engine(&cpu), inputLog(NULL), instructionsPerFrame(instructionsPerFrame) {
+    frameReady = false;
+    frames = 0;
+    instructions = 0;
+    idleFrames = 0;
+}
+
+void Scheduler::setInstructionsPerFrame(int instructionsPerFrame) {
+    this->instructionsPerFrame = instructionsPerFrame;
+}
+
+int Scheduler::getInstructionsPerFrame() {
+    return instructionsPerFrame;
+}
+
+void Scheduler::setEngine(Engine &engine) {
+    this->engine = &engine;
+}
+
+void Scheduler::setInputLog(InputLog *inputLog) {
+    this->inputLog = inputLog;
+}
+
+void Scheduler::onTimer() {
+    if (!inputLog) {
+        cpu.decrementTimers();
+    }
+    frameReady = true;
+}
+
+void Scheduler::executeFrame() {
+    if (instructionsPerFrame == TURBO) {
+        while (!frameReady) {
+            instructions += engine->run(TURBO_CHUNK);
+            if (cpu.wasIdle()) {
+                // Nothing changes before the tick
+                idleFrames++;
+                return;
+            }
+            timer.poll();
+        }
+    } else {
+        instructions += engine->run(instructionsPerFrame);
+        if (cpu.wasIdle()) {
+            idleFrames++;
+        }
+    }
+}
+
+void Scheduler::run() {
+    if (inputLog) {
+        timer.poll();
+        if (!frameReady) {
+            timer.idle();
+            return;
+        }
+        frameReady = false;
+        runFrame();
+        return;
+    }
+    keyboard.scan();
+    timer.poll();
+    if (!frameReady) {
+        timer.idle();
+        return;
+    }
+    frameReady = false;
+
+    executeFrame();
+    presenter.tick();
+    frames++;
+}
+
+void Scheduler::runFrame() {
+    int budget = instructionsPerFrame == TURBO ? DEFAULT_INSTRUCTIONS_PER_FRAME : instructionsPerFrame;
+    if (inputLog) {
+        inputLog->step(keyboard);
+    } else {
+        keyboard.scan();
+    }
+    instructions += engine->run(budget);
+    if (cpu.wasIdle()) {
+        idleFrames++;
+    }
+    cpu.decrementTimers();
+    presenter.tick();
+    frames++;
+}
+
+unsigned long Scheduler::getFrames() {
+    return frames;
+}
+
+unsigned long Scheduler::getInstructions() {
+    return instructions;
+}
+
+unsigned long Scheduler::getIdleFrames() {
+    return idleFrames;
+}
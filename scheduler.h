@@ -0,0 +1,135 @@
+#ifndef SCHEDULER_H_INCLUDED
+#define SCHEDULER_H_INCLUDED
+
+#include "hal.h"
+#include "cpu.h"
+#include "keyboard.h"
+#include "presenter.h"
+#include "input_log.h"
+
+// Frames per second, rate timers are decremented at
+#define FRAME_RATE 60
+// Instructions executed per frame by default (600 Hz)
+#define DEFAULT_INSTRUCTIONS_PER_FRAME 10
+// Instructions per frame value selecting turbo mode
+#define TURBO 0
+// Instructions executed between two frame flag checks in turbo mode
+#define TURBO_CHUNK 64
+
+/**
+ * Runs the emulation in 60 Hz frames.
+ *
+ * Frames are driven by a FrameTimer calling onTimer(), which decrements
+ * the timers and sets the frame flag. Each frame executes a fixed budget
+ * of instructions and presents the screen, then sleeps until the next tick.
+ * In turbo mode instructions are executed until the next tick, or until
+ * the CPU reaches an idle loop. Keypad is scanned between frames.
+ *
+ * With an input log set, runs are deterministic: keys are set once at
+ * the start of each frame by the log and timers are decremented by the
+ * frame itself, so a slow frame delays the run instead of changing it.
+ */
+class Scheduler {
+    private:
+        CPU &cpu;
+        Keyboard &keyboard;
+        Presenter &presenter;
+        FrameTimer &timer;
+        // Runs the instructions, the CPU itself by default
+        Engine *engine;
+        // Log keys are recorded to or replayed from, NULL if none
+        InputLog *inputLog;
+
+        // Instructions executed per frame, TURBO for as many as fit
+        int instructionsPerFrame;
+
+        // Set by the timer when a new frame starts
+        volatile bool frameReady;
+
+        // Counters
+        unsigned long frames;
+        unsigned long instructions;
+        // Frames in which the CPU reached an idle loop
+        unsigned long idleFrames;
+
+        /**
+         * Executes instructions of one frame.
+         */
+        void executeFrame();
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param cpu CPU to be run
+         * @param keyboard Keyboard to be scanned
+         * @param presenter Presenter showing the screen
+         * @param timer Timer calling onTimer() at FRAME_RATE
+         * @param instructionsPerFrame Instructions executed per frame, TURBO for as many as fit
+         */
+        Scheduler(CPU &cpu, Keyboard &keyboard, Presenter &presenter, FrameTimer &timer, int instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME);
+
+        /**
+         * Sets emulation speed.
+         *
+         * @param instructionsPerFrame Instructions executed per frame, TURBO for as many as fit
+         */
+        void setInstructionsPerFrame(int instructionsPerFrame);
+
+        /**
+         * @return Instructions executed per frame, TURBO for as many as fit
+         */
+        int getInstructionsPerFrame();
+
+        /**
+         * Sets engine running the instructions.
+         *
+         * @param engine Engine working on the scheduled CPU
+         */
+        void setEngine(Engine &engine);
+
+        /**
+         * Sets input log keys of each frame are recorded to or replayed
+         * from. Set before the timer is started.
+         *
+         * @param inputLog Log, NULL to scan the keypad between frames
+         */
+        void setInputLog(InputLog *inputLog);
+
+        /**
+         * Handles the 60 Hz tick: decrements timers and sets the frame flag.
+         * Called from the timer interrupt.
+         */
+        void onTimer();
+
+        /**
+         * Scans the keypad and runs a frame if the frame flag is set,
+         * otherwise sleeps until the next interrupt. Called from loop().
+         */
+        void run();
+
+        /**
+         * Scans the keypad, or steps the input log, and runs one frame
+         * as fast as possible, ticking the timers itself.
+         * Used for headless runs without a timer.
+         * Turbo mode runs DEFAULT_INSTRUCTIONS_PER_FRAME instructions.
+         */
+        void runFrame();
+
+        /**
+         * @return Number of frames run
+         */
+        unsigned long getFrames();
+
+        /**
+         * @return Number of instructions executed
+         */
+        unsigned long getInstructions();
+
+        /**
+         * @return Number of frames in which the CPU reached an idle loop
+         */
+        unsigned long getIdleFrames();
+};
+
+#endif
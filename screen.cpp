@@ -1,54 +1,224 @@
 #include "screen.h"
 
-Screen::Screen(int mosi, int clk, int dc, int reset, int cs, int scale) : display(mosi, clk, dc, reset, cs), scale(scale) {
+#include <string.h>
+
+#include "snapshot.h"
+
+// Leftmost pixel of a buffer word
+#define PIXEL_MASK 0x8000000000000000ULL
+
+/**
+ * Spreads bits of a byte to bit 0 of eight bytes,
+ * most significant bit going to the lowest byte.
+ */
+static inline uint64_t spreadBits(byte bits) {
+    return ((bits * 0x8040201008040201ULL) >> 7) & 0x0101010101010101ULL;
+}
+
+Screen::Screen(Display &display, int scale) : display(display), scale(scale), changedRows(0), pendingDraws(0), latency(NULL) {
     width = DEFAULT_WIDTH;
     height = DEFAULT_HEIGHT;
-    display.begin(SSD1306_SWITCHCAPVCC);
-    display.setTextColor(WHITE);
+    display.begin();
     clear();
 }
 
 void Screen::markPixel(int x, int y, bool on) {
-    int color = on == true ? 1 : 0;
-    display.fillRect(x * scale, y * scale, scale, scale, color);
-    buf[x][y] = on;
+    uint64_t mask = PIXEL_MASK >> (x & 63);
+    if (on) {
+        buf[y][x >> 6] |= mask;
+    } else {
+        buf[y][x >> 6] &= ~mask;
+    }
+    markDirty(x, y, 1);
+}
+
+bool Screen::drawRow(int x, int y, byte sprite) {
+    uint64_t *row = buf[y];
+    x = x % width;
+    if (sprite == 0) {
+        return false;
+    }
+    if (x + 8 > width) {
+        markDirty(x, y, width - x);
+        markDirty(0, y, x + 8 - width);
+    } else {
+        markDirty(x, y, 8);
+    }
+
+    if (width == 64) {
+        // Whole row is one word, wrapping is a rotation
+        uint64_t bits = (uint64_t)sprite << 56;
+        if (x != 0) {
+            bits = (bits >> x) | (bits << (64 - x));
+        }
+        bool collision = (row[0] & bits) != 0;
+        row[0] ^= bits;
+        return collision;
+    }
+
+    bool collision = false;
+    for (int i = 0; i < 8; i++) {
+        if (sprite & (0x80 >> i)) {
+            int px = (x + i) % width;
+            uint64_t mask = PIXEL_MASK >> (px & 63);
+            collision |= (row[px >> 6] & mask) != 0;
+            row[px >> 6] ^= mask;
+        }
+    }
+    return collision;
+}
+
+void Screen::markDirty(int x, int y, int count) {
+    changedRows |= 1ULL << y;
+    int first = x * scale;
+    int last = (x + count) * scale - 1;
+    if (first >= PANEL_WIDTH) {
+        return;
+    }
+    if (last >= PANEL_WIDTH) {
+        last = PANEL_WIDTH - 1;
+    }
+    uint32_t mask = (0xFFFFFFFFUL << (first / DIRTY_COLUMNS)) & (0xFFFFFFFFUL >> (31 - last / DIRTY_COLUMNS));
+
+    int top = y * scale / PAGE_HEIGHT;
+    int bottom = ((y + 1) * scale - 1) / PAGE_HEIGHT;
+    if (bottom >= PANEL_PAGES) {
+        bottom = PANEL_PAGES - 1;
+    }
+    for (int page = top; page <= bottom; page++) {
+        dirty[page] |= mask;
+    }
+}
+
+void Screen::markAllDirty() {
+    changedRows = ~0ULL;
+    for (int page = 0; page < PANEL_PAGES; page++) {
+        dirty[page] = 0xFFFFFFFFUL;
+    }
+}
+
+void Screen::markAllClean() {
+    for (int page = 0; page < PANEL_PAGES; page++) {
+        dirty[page] = 0;
+    }
+}
+
+void Screen::renderPage(int page, int first, int last, byte *data) {
+    int columns = width * scale;
+    if (columns > PANEL_WIDTH) {
+        columns = PANEL_WIDTH;
+    }
+    for (int c = columns; c <= last; c++) {
+        data[c] = 0;
+    }
+    if (last >= columns) {
+        last = columns - 1;
+    }
+
+    // Screen rows shown by page bits
+    const uint64_t *rows[PAGE_HEIGHT];
+    int count = 0;
+    for (int b = 0; b < PAGE_HEIGHT; b++) {
+        int y = (page * PAGE_HEIGHT + b) / scale;
+        if (y >= height) {
+            break;
+        }
+        rows[count++] = buf[y];
+    }
+
+    int blockColumns = 8 * scale;
+    for (int block = first / blockColumns; block <= last / blockColumns && block < width / 8; block++) {
+        int word = block >> 3;
+        int shift = 56 - 8 * (block & 7);
+        // Byte i holds page column of screen pixel block * 8 + i
+        uint64_t bytes = 0;
+        for (int b = 0; b < count; b++) {
+            bytes |= spreadBits((byte)(rows[b][word] >> shift)) << b;
+        }
+        int c = block * blockColumns;
+        for (int i = 0; i < 8; i++) {
+            byte column = (byte)(bytes >> (8 * i));
+            for (int s = 0; s < scale; s++, c++) {
+                if (c >= first && c <= last) {
+                    data[c] = column;
+                }
+            }
+        }
+    }
 }
 
 void Screen::show() {
-    display.display();
+    byte data[PANEL_WIDTH];
+    bool changed = false;
+    for (int page = 0; page < PANEL_PAGES; page++) {
+        uint32_t bits = dirty[page];
+        changed |= bits != 0;
+        // Each run of changed columns is sent separately
+        while (bits) {
+            int start = __builtin_ctz(bits);
+            uint32_t rest = ~(bits >> start);
+            int length = rest ? __builtin_ctz(rest) : 32 - start;
+            int first = start * DIRTY_COLUMNS;
+            int last = (start + length) * DIRTY_COLUMNS - 1;
+
+            renderPage(page, first, last, data);
+            display.writePage(page, first, data + first, last - first + 1);
+            bits &= ~(rest ? ((1UL << length) - 1) << start : 0xFFFFFFFFUL << start);
+        }
+    }
+    markAllClean();
+    pendingDraws = 0;
+    if (changed && latency) {
+        latency->onPresent();
+    }
+}
+
+void Screen::setLatency(InputLatency *latency) {
+    this->latency = latency;
+}
+
+void Screen::requestShow() {
+    pendingDraws++;
+}
+
+unsigned int Screen::getPendingDraws() {
+    return pendingDraws;
 }
 
 bool Screen::isPixelOn(int x, int y) {
-    return buf[x][y];
+    return (buf[y][x >> 6] & (PIXEL_MASK >> (x & 63))) != 0;
 }
 
 void Screen::clear() {
     memset(buf, 0, sizeof(buf));
-    display.clearDisplay();
-    display.setCursor(0, 0);
-    display.display();
+    display.clear();
+    markAllDirty();
+    requestShow();
 }
 
-void Screen::displayText(char *text) {
+void Screen::displayText(const char *text) {
     display.print(text);
-    display.display();
+    display.update();
 }
 
 void Screen::displayText(int number) {
     display.print(number);
-    display.display();
+    display.update();
 }
 
 void Screen::setWidth(int width) {
     this->width = width;    
+    markAllDirty();
 }
 
 void Screen::setHeight(int height) {
     this->height = height;
+    markAllDirty();
 }
 
 void Screen::setScale(int scale1) {
     scale = scale1;
+    markAllDirty();
 }
 
 int Screen::getWidth() {
@@ -63,3 +233,40 @@ int Screen::getScale() {
     return scale;
 }
 
+void Screen::getRow(int y, byte *data) {
+    // Locals, stores through data could alias the members
+    const uint64_t *row = buf[y];
+    int length = width / 8;
+    for (int i = 0; i < length; i++) {
+        data[i] = (byte)(row[i >> 3] >> (56 - (i & 7) * 8));
+    }
+}
+
+uint64_t Screen::takeChangedRows() {
+    uint64_t rows = changedRows;
+    changedRows = 0;
+    return rows;
+}
+
+void Screen::saveState(StateWriter &out) {
+    byte row[MAX_WIDTH / 8];
+    for (int y = 0; y < height; y++) {
+        getRow(y, row);
+        out.putPacked(row, width / 8);
+    }
+}
+
+void Screen::loadState(StateReader &in) {
+    byte row[MAX_WIDTH / 8];
+    for (int y = 0; y < height; y++) {
+        in.getPacked(row, width / 8);
+        for (int w = 0; w < ROW_WORDS; w++) {
+            buf[y][w] = 0;
+        }
+        for (int i = 0; i < width / 8; i++) {
+            buf[y][i / 8] |= (uint64_t)row[i] << (56 - (i % 8) * 8);
+        }
+    }
+    markAllDirty();
+    requestShow();
+}
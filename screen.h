@@ -1,40 +1,100 @@
 #ifndef SCREEN_H_INCLUDED
 #define SCREEN_H_INCLUDED
 
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
+#include "hal.h"
+#include "latency.h"
 
 #define DEFAULT_WIDTH 64
 #define DEFAULT_HEIGHT 32
 #define DEFAULT_SCALE 1
 
+// Largest supported screen (hires)
+#define MAX_WIDTH 128
+#define MAX_HEIGHT 64
+// Number of 64 bit words in a buffer row
+#define ROW_WORDS (MAX_WIDTH / 64)
+
+// Size of panel the screen is drawn to
+#define PANEL_WIDTH 128
+#define PANEL_HEIGHT 64
+// Number of pixel rows in a panel page
+#define PAGE_HEIGHT 8
+// Number of panel pages
+#define PANEL_PAGES (PANEL_HEIGHT / PAGE_HEIGHT)
+// Number of panel columns tracked by one dirty bit
+#define DIRTY_COLUMNS 4
+
+class StateWriter;
+class StateReader;
+
 /**
- * CHIP-8 screen realized with Adafruit_SSD1306 compatible display
+ * CHIP-8 screen drawn to a Display backend
  */
 class Screen {
     private:
-        // Display object
-        Adafruit_SSD1306 display;
+        // Display backend
+        Display &display;
         // Screen width in pixels
         int width;
         // Screen height in pixels
         int height;
         // Screen scale
         int scale;
-        // Screen buffer
-        bool buf[64][64];
+        // Screen buffer, one bit per pixel, leftmost pixel in the
+        // most significant bit of the first word of a row
+        uint64_t buf[MAX_HEIGHT][ROW_WORDS];
+        // Panel columns changed since last show(), per page,
+        // one bit for each DIRTY_COLUMNS columns
+        uint32_t dirty[PANEL_PAGES];
+        // Rows changed since last takeChangedRows(), bit y for row y
+        uint64_t changedRows;
+        // Number of draws requested since last show()
+        unsigned int pendingDraws;
+        // Latency measurement, NULL if disabled
+        InputLatency *latency;
+
+        // Screen owns the frame buffer, copies are not allowed
+        Screen(const Screen &) = delete;
+        Screen &operator=(const Screen &) = delete;
+
+        /**
+         * Converts buffer to column bytes of one panel page,
+         * scaling the pixels up.
+         *
+         * @param page Number of panel page
+         * @param first First panel column to be converted
+         * @param last Last panel column to be converted
+         * @param data Output, indexed by panel column
+         */
+        void renderPage(int page, int first, int last, byte *data);
+
+        /**
+         * Marks panel area showing given screen pixels as changed.
+         *
+         * @param x The x coordinate of leftmost pixel
+         * @param y The y coordinate of the row
+         * @param count Number of pixels in the row
+         */
+        void markDirty(int x, int y, int count);
+
+        /**
+         * Marks whole panel as changed.
+         */
+        void markAllDirty();
+
+        /**
+         * Marks whole panel as unchanged.
+         */
+        void markAllClean();
         
     public:
         /**
          * Default constructor.
          * 
-         * @param mosi Number of pin screen MOSI is connected to
-         * @param clk Number of pin screen CLK is connected to
-         * @param dc Number of pin screen DC is connected to
-         * @param reset Number of pin screen RESET is connected to
+         * @param display Display backend to draw to
          * @param scale Scale of screen pixels, if not specified DEFAULT_SCALE will be used
          */
-        Screen(int mosi, int clk, int dc, int reset, int cs, int scale = DEFAULT_SCALE);
+        Screen(Display &display, int scale = DEFAULT_SCALE);
 
         /**
          * Checks if pixel on given coordinates is turned on,
@@ -57,7 +117,19 @@ class Screen {
         void markPixel(int x, int y, bool on);
 
         /**
-         * Clears the screen.
+         * Draws one 8 pixel wide sprite row by XOR-ing it into the buffer.
+         * Pixels that go over the right edge wrap around.
+         *
+         * @param x The x coordinate of leftmost pixel
+         * @param y The y coordinate of the row
+         * @param sprite Sprite row, leftmost pixel in the most significant bit
+         * @return <code>true</code> if any pixel was turned off,
+         *         <code>false</code> otherwise
+         */
+        bool drawRow(int x, int y, byte sprite);
+
+        /**
+         * Clears the screen. Panel is redrawn on next show().
          */
         void clear();
 
@@ -66,7 +138,7 @@ class Screen {
          * 
          * @param text Text to be displayed
          */
-        void displayText(char* text);
+        void displayText(const char* text);
 
         /**
          * Displays given number to the screen.
@@ -76,10 +148,29 @@ class Screen {
         void displayText(int number);
 
         /**
-         * Updates screen image with changes made to buffer
+         * Updates screen image with changes made to buffer.
+         * Only panel pages and columns changed since last call are sent.
          */
         void show();
 
+        /**
+         * Enables latency measurement.
+         *
+         * @param latency Measurement shown frames are reported to, NULL to disable
+         */
+        void setLatency(InputLatency *latency);
+
+        /**
+         * Notes that buffer was drawn to and should be shown.
+         * Showing is left to the presentation scheduler.
+         */
+        void requestShow();
+
+        /**
+         * @return Number of draws requested since last show()
+         */
+        unsigned int getPendingDraws();
+
         /*
          * Sets the width of the screen.
          * 
@@ -115,6 +206,37 @@ class Screen {
          */
         int getHeight();
 
+        /**
+         * Reads a row of the frame buffer, eight pixels per byte.
+         *
+         * @param y The y coordinate of the row
+         * @param data Output, width / 8 bytes, leftmost pixel in the most significant bit
+         */
+        void getRow(int y, byte *data);
+
+        /**
+         * Returns rows drawn to or cleared since the last call. Rows may
+         * be reported even if drawing left their pixels unchanged.
+         *
+         * @return Bit y set if row y may have changed
+         */
+        uint64_t takeChangedRows();
+
+        /**
+         * Writes the frame buffer, one bit per pixel, each row
+         * run-length encoded on its own.
+         *
+         * @param out Snapshot being written
+         */
+        void saveState(StateWriter &out);
+
+        /**
+         * Reads frame buffer written by saveState(). Panel is redrawn on next show().
+         *
+         * @param in Snapshot being read
+         */
+        void loadState(StateReader &in);
+
         /**
          * Returns scale of the screen.
          * 
@@ -0,0 +1,213 @@
+#include "snapshot.h"
+
+#include <string.h>
+
+#include "cpu.h"
+
+// Identifies snapshot files
+static const byte SNAPSHOT_MAGIC[] = {'C', '8', 'S', 'N'};
+// Bytes summed between two reductions of the checksum, sums stay below 2^32
+#define CHECKSUM_BLOCK 2048
+
+StateWriter::StateWriter(byte *buffer, int size) : buffer(buffer), size(size), position(0), failed(false) {}
+
+void StateWriter::putBytes(const byte *data, int length) {
+    if (position + length > size) {
+        failed = true;
+        length = size - position;
+    }
+    memcpy(buffer + position, data, length);
+    position += length;
+}
+
+/**
+ * Counts bytes equal to the first one, comparing a word at a time.
+ *
+ * @param data Bytes to be scanned
+ * @param limit Most bytes counted
+ * @return Length of the run, at least 1
+ */
+static inline int runLength(const byte *data, int limit) {
+    if (limit < 3 || data[1] != data[0] || data[2] != data[0]) {
+        return limit > 1 && data[1] == data[0] ? 2 : 1;
+    }
+    uint64_t pattern = data[0] * 0x0101010101010101ULL;
+    int run = 3;
+    while (run + 8 <= limit) {
+        uint64_t word;
+        memcpy(&word, data + run, sizeof(word));
+        if (word != pattern) {
+            break;
+        }
+        run += 8;
+    }
+    while (run < limit && data[run] == data[0]) {
+        run++;
+    }
+    return run;
+}
+
+void StateWriter::putPacked(const byte *data, int length) {
+    const byte *end = data + length;
+    while (data < end) {
+        int left = (int)(end - data);
+        int run = runLength(data, left < 130 ? left : 130);
+        if (run >= 3) {
+            putByte(run + 125);
+            putByte(data[0]);
+            data += run;
+            continue;
+        }
+        // Literals until the next run of three or more, so that
+        // packing never grows data by more than a byte in 128
+        int limit = left < 128 ? left : 128;
+        int count = run;
+        while (count < limit && !(count + 2 < left && data[count] == data[count + 1] && data[count] == data[count + 2])) {
+            count++;
+        }
+        putByte(count - 1);
+        putBytes(data, count);
+        data += count;
+    }
+}
+
+int StateWriter::getLength() {
+    return position;
+}
+
+bool StateWriter::isOk() {
+    return !failed;
+}
+
+StateReader::StateReader(const byte *buffer, int size) : buffer(buffer), size(size), position(0), failed(false) {}
+
+void StateReader::getBytes(byte *data, int length) {
+    for (int i = 0; i < length; i++) {
+        data[i] = getByte();
+    }
+}
+
+void StateReader::getPacked(byte *data, int length) {
+    int i = 0;
+    while (i < length && !failed) {
+        byte control = getByte();
+        if (control < 128) {
+            int count = control + 1;
+            if (i + count > length) {
+                failed = true;
+                return;
+            }
+            for (int j = 0; j < count; j++) {
+                byte value = getByte();
+                if (data) {
+                    data[i] = value;
+                }
+                i++;
+            }
+        } else {
+            int run = control - 125;
+            byte value = getByte();
+            if (i + run > length) {
+                failed = true;
+                return;
+            }
+            for (int j = 0; j < run; j++) {
+                if (data) {
+                    data[i] = value;
+                }
+                i++;
+            }
+        }
+    }
+}
+
+int StateReader::getPosition() {
+    return position;
+}
+
+bool StateReader::isOk() {
+    return !failed;
+}
+
+uint16_t Snapshot::checksum(const byte *data, int length) {
+    // M0 has no divider, sums are reduced once per block
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    while (length > 0) {
+        int block = length < CHECKSUM_BLOCK ? length : CHECKSUM_BLOCK;
+        for (int i = 0; i < block; i++) {
+            sum1 += data[i];
+            sum2 += sum1;
+        }
+        sum1 %= 255;
+        sum2 %= 255;
+        data += block;
+        length -= block;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+int Snapshot::save(CPU &cpu, Memory &memory, Screen &screen, byte *buffer, int size) {
+    StateWriter out(buffer, size);
+    out.putBytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    out.putByte(SNAPSHOT_VERSION);
+    out.putByte(cpu.getQuirks());
+    out.putByte(screen.getWidth());
+    out.putByte(screen.getHeight());
+    cpu.saveState(out);
+    memory.saveState(out);
+    screen.saveState(out);
+    out.putWord(checksum(buffer, out.getLength()));
+    return out.isOk() ? out.getLength() : -1;
+}
+
+bool Snapshot::restore(CPU &cpu, Memory &memory, Screen &screen, const byte *buffer, int length) {
+    // Whole snapshot is checked before anything is changed
+    if (length < SNAPSHOT_HEADER_SIZE + SNAPSHOT_CHECKSUM_SIZE) {
+        return false;
+    }
+    int body = length - SNAPSHOT_CHECKSUM_SIZE;
+    if (checksum(buffer, body) != (buffer[body] | (buffer[body + 1] << 8))) {
+        return false;
+    }
+    StateReader check(buffer, body);
+    for (unsigned int i = 0; i < sizeof(SNAPSHOT_MAGIC); i++) {
+        if (check.getByte() != SNAPSHOT_MAGIC[i]) {
+            return false;
+        }
+    }
+    byte version = check.getByte();
+    // State of a run with other quirks is refused
+    byte quirks = check.getByte();
+    if (version != SNAPSHOT_VERSION || quirks != cpu.getQuirks()
+        || check.getByte() != screen.getWidth() || check.getByte() != screen.getHeight()) {
+        return false;
+    }
+    byte cpuState[SNAPSHOT_CPU_SIZE];
+    check.getBytes(cpuState, SNAPSHOT_CPU_SIZE);
+    check.getPacked(NULL, MEMORY_SIZE);
+    for (int y = 0; y < screen.getHeight(); y++) {
+        check.getPacked(NULL, screen.getWidth() / 8);
+    }
+    if (!check.isOk() || check.getPosition() != body) {
+        return false;
+    }
+
+    StateReader in(buffer + SNAPSHOT_HEADER_SIZE, body - SNAPSHOT_HEADER_SIZE);
+    if (!cpu.loadState(in)) {
+        return false;
+    }
+    memory.loadState(in);
+    screen.loadState(in);
+    return in.isOk();
+}
+
+bool Snapshot::save(CPU &cpu, Memory &memory, Screen &screen, Storage &storage, const char *name, byte *buffer) {
+    int length = save(cpu, memory, screen, buffer, SNAPSHOT_MAX_SIZE);
+    return length > 0 && storage.write(name, buffer, length) == length;
+}
+
+bool Snapshot::restore(CPU &cpu, Memory &memory, Screen &screen, Storage &storage, const char *name, byte *buffer) {
+    int length = storage.read(name, buffer, SNAPSHOT_MAX_SIZE);
+    return length > 0 && restore(cpu, memory, screen, buffer, length);
+}
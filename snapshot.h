@@ -0,0 +1,209 @@
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+#include "hal.h"
+#include "memory.h"
+#include "screen.h"
+
+// Format version written, snapshots of other versions are refused
+#define SNAPSHOT_VERSION 4
+// Size of the header: magic, version, quirks, width, height
+#define SNAPSHOT_HEADER_SIZE 8
+// Size of the CPU section
+#define SNAPSHOT_CPU_SIZE 66
+// Size of the checksum ending a snapshot
+#define SNAPSHOT_CHECKSUM_SIZE 2
+// Worst case size of a packed section of given length
+#define SNAPSHOT_PACKED_SIZE(length) ((length) + ((length) + 127) / 128)
+// Buffer size that fits any snapshot
+#define SNAPSHOT_MAX_SIZE (SNAPSHOT_HEADER_SIZE + SNAPSHOT_CPU_SIZE + SNAPSHOT_PACKED_SIZE(MEMORY_SIZE) \
+    + MAX_HEIGHT * SNAPSHOT_PACKED_SIZE(MAX_WIDTH / 8) + SNAPSHOT_CHECKSUM_SIZE)
+
+/**
+ * Appends state to a snapshot buffer. Multi-byte values are stored
+ * little-endian. Writes past the end of the buffer are dropped and
+ * the writer is marked as failed.
+ */
+class StateWriter {
+    private:
+        byte *buffer;
+        int size;
+        int position;
+        bool failed;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param buffer Buffer to write to
+         * @param size Size of the buffer
+         */
+        StateWriter(byte *buffer, int size);
+
+        inline void putByte(byte value) {
+            if (position < size) {
+                buffer[position++] = value;
+            } else {
+                failed = true;
+            }
+        }
+
+        inline void putWord(uint16_t value) {
+            putByte(value & 0xFF);
+            putByte(value >> 8);
+        }
+
+        inline void putLong(uint32_t value) {
+            putWord(value & 0xFFFF);
+            putWord(value >> 16);
+        }
+
+        void putBytes(const byte *data, int length);
+
+        /**
+         * Writes bytes run-length encoded (PackBits): control byte N below
+         * 128 is followed by N + 1 literal bytes, N of 128 or more by one
+         * byte repeated N - 125 times (3 to 130).
+         *
+         * @param data Bytes to be written
+         * @param length Number of bytes
+         */
+        void putPacked(const byte *data, int length);
+
+        /**
+         * @return Number of bytes written
+         */
+        int getLength();
+
+        /**
+         * @return <code>true</code> if everything fit the buffer, <code>false</code> otherwise
+         */
+        bool isOk();
+};
+
+/**
+ * Reads state from a snapshot buffer written by StateWriter. Reads
+ * past the end return zeros and mark the reader as failed.
+ */
+class StateReader {
+    private:
+        const byte *buffer;
+        int size;
+        int position;
+        bool failed;
+
+    public:
+        /**
+         * Default constructor.
+         *
+         * @param buffer Buffer to read from
+         * @param size Number of bytes in the buffer
+         */
+        StateReader(const byte *buffer, int size);
+
+        inline byte getByte() {
+            if (position < size) {
+                return buffer[position++];
+            }
+            failed = true;
+            return 0;
+        }
+
+        inline uint16_t getWord() {
+            uint16_t low = getByte();
+            return low | (getByte() << 8);
+        }
+
+        inline uint32_t getLong() {
+            uint32_t low = getWord();
+            return low | ((uint32_t)getWord() << 16);
+        }
+
+        void getBytes(byte *data, int length);
+
+        /**
+         * Reads bytes written by StateWriter::putPacked().
+         *
+         * @param data Output, NULL to only skip the bytes
+         * @param length Number of bytes unpacked
+         */
+        void getPacked(byte *data, int length);
+
+        /**
+         * @return Number of bytes read
+         */
+        int getPosition();
+
+        /**
+         * @return <code>true</code> if all reads were in bounds and well formed, <code>false</code> otherwise
+         */
+        bool isOk();
+};
+
+class CPU;
+
+/**
+ * Versioned binary snapshot of the machine: CPU registers, I, PC,
+ * stack, timers, key wait and random generator, run-length encoded
+ * RAM and packed framebuffer, and quirk flags of the CPU's profile. Ends with a Fletcher-16 checksum.
+ * Snapshots of the built in ROMs take 390 to 620 bytes, at most
+ * SNAPSHOT_MAX_SIZE.
+ */
+class Snapshot {
+    public:
+        /**
+         * Writes the machine state to a buffer.
+         *
+         * @param cpu CPU to be saved
+         * @param memory Memory of the CPU
+         * @param screen Screen of the CPU
+         * @param buffer Output
+         * @param size Size of the buffer, SNAPSHOT_MAX_SIZE always fits
+         * @return Length of the snapshot, -1 if it does not fit the buffer
+         */
+        static int save(CPU &cpu, Memory &memory, Screen &screen, byte *buffer, int size);
+
+        /**
+         * Restores machine state from a snapshot. Nothing is changed
+         * if the snapshot is damaged or does not fit the machine.
+         *
+         * @param cpu CPU to be restored
+         * @param memory Memory of the CPU
+         * @param screen Screen of the CPU
+         * @param buffer Snapshot
+         * @param length Length of the snapshot
+         * @return <code>true</code> if state was restored, <code>false</code> otherwise
+         */
+        static bool restore(CPU &cpu, Memory &memory, Screen &screen, const byte *buffer, int length);
+
+        /**
+         * Saves the machine state to a file.
+         *
+         * @param storage Storage to write to
+         * @param name Name/path of the file
+         * @param buffer Work buffer, SNAPSHOT_MAX_SIZE bytes
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        static bool save(CPU &cpu, Memory &memory, Screen &screen, Storage &storage, const char *name, byte *buffer);
+
+        /**
+         * Restores machine state from a file.
+         *
+         * @param storage Storage to read from
+         * @param name Name/path of the file
+         * @param buffer Work buffer, SNAPSHOT_MAX_SIZE bytes
+         * @return <code>true</code> if operation is successful, <code>false</code> otherwise
+         */
+        static bool restore(CPU &cpu, Memory &memory, Screen &screen, Storage &storage, const char *name, byte *buffer);
+
+        /**
+         * Fletcher-16 checksum, as ending snapshots.
+         *
+         * @param data Bytes to be summed
+         * @param length Number of bytes
+         * @return Checksum
+         */
+        static uint16_t checksum(const byte *data, int length);
+};
+
+#endif
@@ -1,16 +1,11 @@
 #include "speaker.h"
 
-#include <Arduino.h>
-
-Speaker::Speaker(int pin) : pin(pin) {
-    pinMode(pin, OUTPUT);
-}
+Speaker::Speaker(Audio &audio) : audio(audio) {}
 
 void Speaker::playSound() {
-    digitalWrite(pin, HIGH);
+    audio.play();
 }
 
 void Speaker::muteSound() {
-    digitalWrite(pin, LOW);
+    audio.mute();
 }
-
@@ -1,29 +1,31 @@
 #ifndef SPEAKER_H_INCLUDED
 #define SPEAKER_H_INCLUDED
 
+#include "hal.h"
+
 /**
  * Piezo buzzer representing speaker.
  */
 class Speaker {
     private:
-        // Number of pin buzzer is connected to
-        int pin;
+        // Buzzer backend
+        Audio &audio;
         
     public:
         /**
          * Default constructor.
          * 
-         * @param pin Number of pin buzzer is connected to
+         * @param audio Buzzer backend
          */
-        Speaker(int pin);
+        Speaker(Audio &audio);
 
         /**
-         * Sets the pin to <code>HIGH</code>
+         * Starts the tone.
          */
         void playSound();
 
         /**
-         * Sets the pin to <code>LOW</code>
+         * Stops the tone.
          */
         void muteSound();
 };